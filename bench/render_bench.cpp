@@ -0,0 +1,355 @@
+// Drives the scene through fixed scenarios on an offscreen GLES2 context,
+// meant to run on Mesa's software rasterizer without any GPU or display.
+// Has to be started from the repository root so that res/ can be found.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <alloc_track.hpp>
+#include <game.hpp>
+
+struct headless_context {
+	headless_context(int w, int h) {
+		auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+				eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+		if (get_platform_display)
+			dpy_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (dpy_ == EGL_NO_DISPLAY)
+			dpy_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		if (dpy_ == EGL_NO_DISPLAY || !eglInitialize(dpy_, nullptr, nullptr)) {
+			std::cerr << "Failed to initialize EGL\n";
+			return;
+		}
+
+		const EGLint config_attrs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+			EGL_RED_SIZE, 8,
+			EGL_GREEN_SIZE, 8,
+			EGL_BLUE_SIZE, 8,
+			EGL_ALPHA_SIZE, 8,
+			EGL_NONE
+		};
+
+		EGLConfig config;
+		EGLint n_configs = 0;
+		if (!eglChooseConfig(dpy_, config_attrs, &config, 1, &n_configs) || !n_configs) {
+			std::cerr << "No EGL config for an RGBA8 GLES2 pbuffer\n";
+			return;
+		}
+
+		eglBindAPI(EGL_OPENGL_ES_API);
+
+		const EGLint surface_attrs[] = {EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE};
+		surf_ = eglCreatePbufferSurface(dpy_, config, surface_attrs);
+
+		const EGLint context_attrs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+		ctx_ = eglCreateContext(dpy_, config, EGL_NO_CONTEXT, context_attrs);
+
+		if (surf_ == EGL_NO_SURFACE || ctx_ == EGL_NO_CONTEXT
+				|| !eglMakeCurrent(dpy_, surf_, surf_, ctx_)) {
+			std::cerr << "Failed to create an EGL context (error 0x"
+				<< std::hex << eglGetError() << std::dec << ")\n";
+			return;
+		}
+
+		ok_ = true;
+		std::cout << "Rendering with " << glGetString(GL_RENDERER) << "\n";
+	}
+
+	~headless_context() {
+		if (dpy_ == EGL_NO_DISPLAY)
+			return;
+
+		eglMakeCurrent(dpy_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (ctx_ != EGL_NO_CONTEXT)
+			eglDestroyContext(dpy_, ctx_);
+		if (surf_ != EGL_NO_SURFACE)
+			eglDestroySurface(dpy_, surf_);
+		eglTerminate(dpy_);
+	}
+
+	headless_context(const headless_context &) = delete;
+	headless_context &operator=(const headless_context &) = delete;
+
+	explicit operator bool() const {
+		return ok_;
+	}
+
+private:
+	EGLDisplay dpy_ = EGL_NO_DISPLAY;
+	EGLSurface surf_ = EGL_NO_SURFACE;
+	EGLContext ctx_ = EGL_NO_CONTEXT;
+	bool ok_ = false;
+};
+
+// Writes the current contents of the default framebuffer.
+bool save_png(const std::string &path, int w, int h) {
+	std::vector<uint8_t> pixels(w * h * 4);
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	// GL rows are bottom-up.
+	std::vector<uint8_t> flipped(pixels.size());
+	for (int y = 0; y < h; y++)
+		std::memcpy(&flipped[y * w * 4], &pixels[(h - y - 1) * w * 4], w * 4);
+
+	auto surf = SDL_CreateRGBSurfaceWithFormatFrom(flipped.data(), w, h, 32, w * 4,
+			SDL_PIXELFORMAT_RGBA32);
+	bool ok = surf && !IMG_SavePNG(surf, path.c_str());
+	SDL_FreeSurface(surf);
+
+	if (!ok)
+		std::cerr << "Failed to save \"" << path << "\": " << SDL_GetError() << "\n";
+	return ok;
+}
+
+struct scenario_desc {
+	scene::scenario sc;
+	std::string_view name;
+};
+
+constexpr std::array<scenario_desc, 4> scenarios{{
+	{scene::scenario::menu, "menu"},
+	{scene::scenario::block_field, "blocks"},
+	{scene::scenario::particle_storm, "particles"},
+	{scene::scenario::game_over, "gameover"},
+}};
+
+struct options {
+	int frames = 600;
+	int warmup = 60;
+	uint64_t seed = 49;
+	std::string only;
+	std::string capture_dir;
+	std::vector<int> capture_frames;
+	bool threaded = false;
+};
+
+void usage(const char *argv0) {
+	std::cerr << "Usage: " << argv0 << " [options]\n"
+		<< "  --frames N         measured frames per scenario (default 600)\n"
+		<< "  --warmup N         unmeasured frames before that (default 60)\n"
+		<< "  --seed N           scene seed (default 49)\n"
+		<< "  --scenario NAME    only run menu, blocks, particles or gameover\n"
+		<< "  --capture DIR      write frames to DIR/<scenario>-<frame>.png\n"
+		<< "  --capture-frame N  frame to capture, may be repeated (default 0)\n"
+		<< "  --threaded         tick on a second thread, rendering whatever it\n"
+		<< "                     published last, as fast as both can go\n";
+}
+
+std::optional<options> parse_options(int argc, char **argv) {
+	options opts;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--threaded") {
+			opts.threaded = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+
+		const char *val = argv[++i];
+		if (arg == "--frames")
+			opts.frames = std::atoi(val);
+		else if (arg == "--warmup")
+			opts.warmup = std::atoi(val);
+		else if (arg == "--seed")
+			opts.seed = std::strtoull(val, nullptr, 0);
+		else if (arg == "--scenario")
+			opts.only = val;
+		else if (arg == "--capture")
+			opts.capture_dir = val;
+		else if (arg == "--capture-frame")
+			opts.capture_frames.push_back(std::atoi(val));
+		else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (!opts.capture_dir.empty() && opts.capture_frames.empty())
+		opts.capture_frames.push_back(0);
+
+	// Which tick a frame shows is up to the scheduler then.
+	if (opts.threaded && !opts.capture_dir.empty()) {
+		std::cerr << "--capture can't be combined with --threaded\n";
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+struct frame_times {
+	std::vector<double> submit; // scene::render(), i.e. building and issuing the commands
+	std::vector<double> total; // the above plus clearing and waiting for the rasterizer
+
+	static double mean(const std::vector<double> &v) {
+		double sum = 0;
+		for (auto t : v)
+			sum += t;
+		return v.empty() ? 0 : sum / v.size();
+	}
+
+	static double percentile(std::vector<double> v, double p) {
+		if (v.empty())
+			return 0;
+
+		auto nth = v.begin() + static_cast<size_t>(p * (v.size() - 1));
+		std::nth_element(v.begin(), nth, v.end());
+		return *nth;
+	}
+};
+
+int main(int argc, char **argv) {
+	auto opts = parse_options(argc, argv);
+	if (!opts)
+		return 1;
+
+	// Never touch a GPU, even if there is one.
+	setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+
+	headless_context ctx{screen::width, screen::height};
+	if (!ctx)
+		return 1;
+
+	using clock = std::chrono::steady_clock;
+	auto ms = [] (clock::duration d) {
+		return std::chrono::duration<double, std::milli>(d).count();
+	};
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< std::left << std::setw(10) << "scenario"
+		<< std::right << std::setw(10) << "submit"
+		<< std::setw(10) << "p99"
+		<< std::setw(10) << "frame"
+		<< std::setw(10) << "p99"
+		<< std::setw(8) << "cmds"
+		<< std::setw(8) << "draws"
+		<< std::setw(10) << "allocs" << "  (ms, per frame)\n";
+
+	input_state input{};
+
+	for (auto &[sc, name] : scenarios) {
+		if (!opts->only.empty() && opts->only != name)
+			continue;
+
+		// A fresh scene for every scenario, so that each one renders the same
+		// frames no matter which others ran.
+		std::optional<scene> s;
+		s.emplace(opts->seed);
+		s->load_scenario(sc);
+
+		frame_times times;
+		render_queue::stats stats{};
+		alloc_counts allocs_start;
+
+		// Keep our own bookkeeping out of the allocation counts.
+		times.submit.reserve(opts->frames);
+		times.total.reserve(opts->frames);
+
+		auto tick = [&] (int i) {
+			if (i == opts->warmup)
+				allocs_start = alloc_tracker::totals();
+
+			s->sustain_scenario(sc);
+			s->tick(1. / 60, input);
+		};
+
+		// Renders whatever was published last, frame is negative while
+		// warming up.
+		auto draw = [&] (int frame) {
+			frame_memory().reset();
+
+			auto start = clock::now();
+
+			glViewport(0, 0, screen::width, screen::height);
+			glClearColor(0.364f, 0.737f, 0.823f, 1.f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			auto submit_start = clock::now();
+			s->render();
+			auto submit_end = clock::now();
+
+			glFinish();
+			auto end = clock::now();
+
+			if (frame < 0 || times.total.size() == static_cast<size_t>(opts->frames))
+				return;
+
+			times.submit.push_back(ms(submit_end - submit_start));
+			times.total.push_back(ms(end - start));
+			stats = s->render_stats();
+
+			if (std::find(opts->capture_frames.begin(), opts->capture_frames.end(), frame)
+					!= opts->capture_frames.end())
+				save_png(opts->capture_dir + "/" + std::string{name} + "-"
+						+ std::to_string(frame) + ".png", screen::width, screen::height);
+		};
+
+		int ticks = opts->warmup + opts->frames;
+		int drawn = 0;
+		auto sim_start = clock::now();
+		double sim_ms = 0;
+
+		if (opts->threaded) {
+			std::atomic<int> ticked = 0;
+			std::thread sim{[&] {
+				for (int i = 0; i < ticks; i++) {
+					tick(i);
+					ticked.store(i + 1, std::memory_order_release);
+				}
+				sim_ms = ms(clock::now() - sim_start);
+			}};
+
+			while (ticked.load(std::memory_order_acquire) < ticks) {
+				draw(ticked.load(std::memory_order_acquire) - opts->warmup - 1);
+				drawn++;
+			}
+
+			sim.join();
+		} else {
+			for (int i = 0; i < ticks; i++) {
+				tick(i);
+				draw(i - opts->warmup);
+				drawn++;
+			}
+		}
+
+		std::cout << std::left << std::setw(10) << name
+			<< std::right << std::setw(10) << frame_times::mean(times.submit)
+			<< std::setw(10) << frame_times::percentile(times.submit, 0.99)
+			<< std::setw(10) << frame_times::mean(times.total)
+			<< std::setw(10) << frame_times::percentile(times.total, 0.99)
+			<< std::setw(8) << stats.commands
+			<< std::setw(8) << stats.draws
+			<< std::setw(10) << static_cast<double>((alloc_tracker::totals() - allocs_start).allocs)
+					/ std::max(opts->frames, 1) << "\n";
+
+		if (opts->threaded)
+			std::cout << "          " << ticks << " ticks in " << sim_ms << " ms, "
+				<< drawn << " frames drawn meanwhile\n";
+	}
+}
@@ -0,0 +1,312 @@
+// Plays many games at once with made up input, without a window, GL context
+// or audio, as fast as every core allows, and reports how they went. Has to
+// be started from the repository root so that res/ can be found.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <game.hpp>
+
+enum class input_mode {
+	idle, random, zigzag
+};
+
+struct input_mode_desc {
+	input_mode mode;
+	std::string_view name;
+};
+
+constexpr std::array<input_mode_desc, 3> input_modes{{
+	{input_mode::idle, "idle"},
+	{input_mode::random, "random"},
+	{input_mode::zigzag, "zigzag"},
+}};
+
+struct options {
+	int games = 1000;
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+	uint64_t seed = 49;
+	input_mode input = input_mode::random;
+	double max_seconds = 600;
+	bool rewind = false;
+};
+
+void usage(const char *argv0) {
+	std::cerr << "Usage: " << argv0 << " [options]\n"
+		<< "  --games N        games to play (default 1000)\n"
+		<< "  --threads N      games played at once (default: one per core)\n"
+		<< "  --seed N         seed of the first game, the rest count up (default 49)\n"
+		<< "  --input MODE     idle, random or zigzag (default random)\n"
+		<< "  --max-seconds S  game time after which a game is cut short (default 600)\n"
+		<< "  --rewind         record rewind history like the game does\n";
+}
+
+std::optional<options> parse_options(int argc, char **argv) {
+	options opts;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--rewind") {
+			opts.rewind = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+
+		const char *val = argv[++i];
+		if (arg == "--games")
+			opts.games = std::atoi(val);
+		else if (arg == "--threads")
+			opts.threads = std::max(std::atoi(val), 1);
+		else if (arg == "--seed")
+			opts.seed = std::strtoull(val, nullptr, 0);
+		else if (arg == "--max-seconds")
+			opts.max_seconds = std::atof(val);
+		else if (arg == "--input") {
+			auto it = std::find_if(input_modes.begin(), input_modes.end(),
+				[&] (const input_mode_desc &d) { return d.name == val; });
+			if (it == input_modes.end()) {
+				usage(argv[0]);
+				return std::nullopt;
+			}
+			opts.input = it->mode;
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	return opts;
+}
+
+// Presses keys the way the chosen mode says, one call per tick.
+struct input_driver {
+	input_driver(input_mode mode, uint64_t seed)
+	: mode_{mode}, rng_{seed, rng_stream::input} { }
+
+	void next(input_state &input, uint64_t tick) {
+		input.begin_frame();
+
+		switch (mode_) {
+			case input_mode::idle:
+				break;
+
+			case input_mode::random:
+				// Change direction every second or so, jump every half.
+				if (rng_.chance(60))
+					hold_(input, tick, SDL_SCANCODE_LEFT, !input.down(SDL_SCANCODE_LEFT));
+				if (rng_.chance(60))
+					hold_(input, tick, SDL_SCANCODE_RIGHT, !input.down(SDL_SCANCODE_RIGHT));
+				hold_(input, tick, SDL_SCANCODE_UP, rng_.chance(30));
+				break;
+
+			case input_mode::zigzag: {
+				// Two seconds each way, jumping twice a second.
+				bool right = tick / 120 % 2;
+				hold_(input, tick, SDL_SCANCODE_RIGHT, right);
+				hold_(input, tick, SDL_SCANCODE_LEFT, !right);
+				hold_(input, tick, SDL_SCANCODE_UP, tick % 30 == 0);
+				break;
+			}
+		}
+	}
+
+private:
+	static void hold_(input_state &input, uint64_t tick, SDL_Scancode key, bool down) {
+		if (down)
+			input.key_down(key, tick);
+		else
+			input.key_up(key, tick);
+	}
+
+	input_mode mode_;
+	rng rng_;
+};
+
+// Per tick cost in whole microseconds, the last bucket takes everything
+// slower than that. The maximum is kept exactly.
+struct tick_histogram {
+	static constexpr size_t buckets = 10000;
+
+	void add(uint64_t us) {
+		counts[std::min<uint64_t>(us, buckets - 1)]++;
+		total += us;
+		max = std::max(max, us);
+		n++;
+	}
+
+	void merge(const tick_histogram &other) {
+		for (size_t i = 0; i < buckets; i++)
+			counts[i] += other.counts[i];
+		total += other.total;
+		max = std::max(max, other.max);
+		n += other.n;
+	}
+
+	uint64_t percentile(double p) const {
+		uint64_t want = p * n, seen = 0;
+		for (size_t i = 0; i < buckets; i++) {
+			seen += counts[i];
+			if (seen > want)
+				return i;
+		}
+		return buckets - 1;
+	}
+
+	double mean() const {
+		return n ? static_cast<double>(total) / n : 0;
+	}
+
+	std::vector<uint64_t> counts = std::vector<uint64_t>(buckets);
+	uint64_t total = 0;
+	uint64_t max = 0;
+	uint64_t n = 0;
+};
+
+struct game_result {
+	double survived = 0;
+	bool cut_short = false;
+	simulation::entity_counts peak{};
+};
+
+// Everything one thread found, merged once they're all done.
+struct thread_results {
+	std::vector<game_result> games;
+	tick_histogram ticks;
+};
+
+game_result play(const art &sheets, const options &opts, uint64_t seed, tick_histogram &ticks) {
+	using clock = std::chrono::steady_clock;
+
+	// The thread pool is the only parallelism, every game ticks serially.
+	simulation sim{seed, sheets, {.workers = 0, .present = false, .rewind = opts.rewind}};
+	sim.reset_to_game();
+
+	input_driver driver{opts.input, seed};
+	input_state input{};
+	input.time_frequency = 60; // driver.next() stamps with the tick
+	game_result res;
+
+	auto max_ticks = static_cast<uint64_t>(opts.max_seconds * 60);
+	for (uint64_t tick = 0; sim.current_state() == simulation::state::game; tick++) {
+		if (tick == max_ticks) {
+			res.cut_short = true;
+			break;
+		}
+
+		driver.next(input, tick);
+
+		auto start = clock::now();
+		sim.tick(1. / 60, input);
+		auto end = clock::now();
+		ticks.add(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+
+		auto c = sim.counts();
+		auto &p = res.peak;
+		p.enemies = std::max(p.enemies, c.enemies);
+		p.bullets = std::max(p.bullets, c.bullets);
+		p.particles = std::max(p.particles, c.particles);
+		p.blocks = std::max(p.blocks, c.blocks);
+		p.powerups = std::max(p.powerups, c.powerups);
+	}
+
+	res.survived = sim.survived();
+	return res;
+}
+
+int main(int argc, char **argv) {
+	auto opts = parse_options(argc, argv);
+	if (!opts)
+		return 1;
+
+	// Only the frame layout is needed, every game shares it.
+	art sheets{layout_only};
+
+	std::vector<thread_results> results(opts->threads);
+	std::atomic<int> next_game = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (auto &r : results)
+		threads.emplace_back([&] {
+			int i;
+			while ((i = next_game.fetch_add(1, std::memory_order_relaxed)) < opts->games)
+				r.games.push_back(play(sheets, *opts, opts->seed + i, r.ticks));
+		});
+
+	for (auto &t : threads)
+		t.join();
+
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<game_result> games;
+	tick_histogram ticks;
+	for (auto &r : results) {
+		games.insert(games.end(), r.games.begin(), r.games.end());
+		ticks.merge(r.ticks);
+	}
+
+	if (games.empty()) {
+		std::cerr << "No games played\n";
+		return 1;
+	}
+
+	std::vector<double> survived;
+	int cut_short = 0;
+	simulation::entity_counts peak{}, peak_sum{};
+	for (auto &g : games) {
+		survived.push_back(g.survived);
+		cut_short += g.cut_short;
+
+		auto both = [] (size_t &max, size_t &sum, size_t v) {
+			max = std::max(max, v);
+			sum += v;
+		};
+		both(peak.enemies, peak_sum.enemies, g.peak.enemies);
+		both(peak.bullets, peak_sum.bullets, g.peak.bullets);
+		both(peak.particles, peak_sum.particles, g.peak.particles);
+		both(peak.blocks, peak_sum.blocks, g.peak.blocks);
+		both(peak.powerups, peak_sum.powerups, g.peak.powerups);
+	}
+	std::sort(survived.begin(), survived.end());
+
+	auto at = [&] (double p) {
+		return survived[static_cast<size_t>(p * (survived.size() - 1))];
+	};
+
+	double mean = 0;
+	for (auto s : survived)
+		mean += s;
+	mean /= survived.size();
+
+	auto n = static_cast<double>(games.size());
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< games.size() << " games on " << opts->threads << " threads in " << wall << " s, "
+		<< ticks.n << " ticks (" << ticks.n / wall << " per second)\n"
+		<< "survived (s)  mean " << mean << "  p10 " << at(.1) << "  p50 " << at(.5)
+		<< "  p90 " << at(.9) << "  max " << survived.back()
+		<< "  (" << cut_short << " cut short)\n"
+		<< "peak          enemies " << peak.enemies << " (" << peak_sum.enemies / n << ")"
+		<< "  bullets " << peak.bullets << " (" << peak_sum.bullets / n << ")"
+		<< "  particles " << peak.particles << " (" << peak_sum.particles / n << ")"
+		<< "  blocks " << peak.blocks << " (" << peak_sum.blocks / n << ")"
+		<< "  powerups " << peak.powerups << " (" << peak_sum.powerups / n << ")"
+		<< "  (max, mean per game)\n"
+		<< "tick (us)     mean " << ticks.mean() << "  p50 " << ticks.percentile(.5)
+		<< "  p99 " << ticks.percentile(.99) << "  p99.9 " << ticks.percentile(.999)
+		<< "  max " << ticks.max << "\n";
+}
@@ -0,0 +1,14 @@
+precision mediump float;
+varying vec2 tex_coord;
+
+uniform sampler2D tex_sampler;
+uniform sampler2D palette_sampler;
+uniform float palette_row;
+uniform vec4 obj_color;
+
+// The palette texture is 256 texels wide with texture2d::max_palettes rows.
+void main() {
+	float index = texture2D(tex_sampler, tex_coord).r * 255.0;
+	vec2 entry = vec2((index + 0.5) / 256.0, (palette_row + 0.5) / 16.0);
+	gl_FragColor = texture2D(palette_sampler, entry) * obj_color;
+}
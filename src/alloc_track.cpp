@@ -0,0 +1,94 @@
+#include <alloc_track.hpp>
+#include <cstdlib>
+#include <new>
+
+// Replacements for the global allocation functions, everything funnels into
+// malloc and free like the default ones. Built without exceptions, so
+// running out of memory aborts instead of throwing.
+
+static void *tracked_alloc(size_t size) {
+	alloc_tracker::record(size);
+
+	if (auto ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	std::abort();
+}
+
+void *operator new(size_t size) {
+	return tracked_alloc(size);
+}
+
+void *operator new[](size_t size) {
+	return tracked_alloc(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	alloc_tracker::record(size);
+	return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	alloc_tracker::record(size);
+	return std::malloc(size ? size : 1);
+}
+
+// The aligned forms, only the size needs rounding up for aligned_alloc.
+static void *tracked_aligned_alloc(size_t size, std::align_val_t align) {
+	alloc_tracker::record(size);
+
+	auto a = static_cast<size_t>(align);
+	auto rounded = size ? (size + a - 1) / a * a : a;
+	if (auto ptr = std::aligned_alloc(a, rounded))
+		return ptr;
+
+	std::abort();
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+	return tracked_aligned_alloc(size, align);
+}
+
+void *operator new[](size_t size, std::align_val_t align) {
+	return tracked_aligned_alloc(size, align);
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+	std::free(ptr);
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <stddef.h>
+#include <stdint.h>
+
+// Count every allocation made through the global operator new, the hooks
+// live in alloc_track.cpp.
+inline constexpr bool track_allocations = true;
+
+// Abort on the first allocation made during a frame the renderer reported
+// as steady-state gameplay, to find and keep out the remaining ones.
+inline constexpr bool forbid_steady_allocations = false;
+
+// Print the allocations per frame every log_allocations_every frames, 0
+// disables it.
+inline constexpr int log_allocations_every = 0;
+
+struct alloc_counts {
+	uint64_t allocs = 0;
+	uint64_t bytes = 0;
+
+	alloc_counts operator-(const alloc_counts &other) const {
+		return {allocs - other.allocs, bytes - other.bytes};
+	}
+};
+
+// Allocations made inside an alloc_scope for a zone are also added to it.
+// Zones are meant to be globals, they link themselves into a list.
+struct alloc_zone {
+	explicit alloc_zone(const char *name)
+	: name_{name}, next_{first_} {
+		first_ = this;
+	}
+
+	alloc_zone(const alloc_zone &) = delete;
+	alloc_zone &operator=(const alloc_zone &) = delete;
+
+	void record(size_t size) {
+		allocs_.fetch_add(1, std::memory_order_relaxed);
+		bytes_.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	alloc_counts counts() const {
+		return {allocs_.load(std::memory_order_relaxed), bytes_.load(std::memory_order_relaxed)};
+	}
+
+	// Returns the counts and starts over from zero.
+	alloc_counts take() {
+		return {allocs_.exchange(0, std::memory_order_relaxed),
+			bytes_.exchange(0, std::memory_order_relaxed)};
+	}
+
+	const char *name() const {
+		return name_;
+	}
+
+	alloc_zone *next() const {
+		return next_;
+	}
+
+	static alloc_zone *first() {
+		return first_;
+	}
+
+private:
+	const char *name_;
+	std::atomic<uint64_t> allocs_{0};
+	std::atomic<uint64_t> bytes_{0};
+	alloc_zone *next_;
+
+	static inline alloc_zone *first_ = nullptr;
+};
+
+struct alloc_tracker {
+	// Called by the operator new hooks.
+	static void record(size_t size) {
+		if constexpr (!track_allocations)
+			return;
+
+		allocs_.fetch_add(1, std::memory_order_relaxed);
+		bytes_.fetch_add(size, std::memory_order_relaxed);
+
+		if (zone_)
+			zone_->record(size);
+
+		if constexpr (forbid_steady_allocations) {
+			if (forbidden_.exchange(false, std::memory_order_relaxed)) {
+				std::fprintf(stderr, "%zu byte allocation during a steady-state frame (zone: %s)\n",
+						size, zone_ ? zone_->name() : "none");
+				assert(!"steady-state frame allocated");
+			}
+		}
+	}
+
+	static alloc_counts totals() {
+		return {allocs_.load(std::memory_order_relaxed), bytes_.load(std::memory_order_relaxed)};
+	}
+
+	// Applies to every thread, the job system workers included.
+	static void forbid(bool forbidden) {
+		forbidden_.store(forbidden, std::memory_order_relaxed);
+	}
+
+	static alloc_zone *current_zone() {
+		return zone_;
+	}
+
+	static void set_zone(alloc_zone *zone) {
+		zone_ = zone;
+	}
+
+private:
+	static inline std::atomic<uint64_t> allocs_{0};
+	static inline std::atomic<uint64_t> bytes_{0};
+	static inline std::atomic<bool> forbidden_{false};
+	static inline thread_local alloc_zone *zone_ = nullptr;
+};
+
+// Attributes allocations made on this thread to a zone until destroyed.
+struct alloc_scope {
+	explicit alloc_scope(alloc_zone &zone)
+	: prev_{alloc_tracker::current_zone()} {
+		alloc_tracker::set_zone(&zone);
+	}
+
+	~alloc_scope() {
+		alloc_tracker::set_zone(prev_);
+	}
+
+	alloc_scope(const alloc_scope &) = delete;
+	alloc_scope &operator=(const alloc_scope &) = delete;
+
+private:
+	alloc_zone *prev_;
+};
+
+// Per-frame accounting for the main loop.
+struct frame_allocs {
+	void begin_frame(bool steady) {
+		start_ = alloc_tracker::totals();
+		if constexpr (forbid_steady_allocations)
+			alloc_tracker::forbid(steady);
+	}
+
+	void end_frame() {
+		alloc_tracker::forbid(false);
+		last_ = alloc_tracker::totals() - start_;
+
+		if constexpr (log_allocations_every > 0) {
+			sum_.allocs += last_.allocs;
+			sum_.bytes += last_.bytes;
+
+			if (++frames_ == log_allocations_every) {
+				std::printf("%.1f allocations (%.0f bytes) per frame",
+						static_cast<double>(sum_.allocs) / frames_,
+						static_cast<double>(sum_.bytes) / frames_);
+				for (auto z = alloc_zone::first(); z; z = z->next())
+					std::printf(", %s: %.1f", z->name(),
+							static_cast<double>(z->take().allocs) / frames_);
+				std::printf("\n");
+
+				sum_ = {};
+				frames_ = 0;
+			}
+		}
+	}
+
+	const alloc_counts &last() const {
+		return last_;
+	}
+
+private:
+	alloc_counts start_;
+	alloc_counts last_;
+	alloc_counts sum_;
+	int frames_ = 0;
+};
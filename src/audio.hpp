@@ -0,0 +1,347 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <sound.hpp>
+#include <spsc_queue.hpp>
+#include <triple_buffer.hpp>
+
+// Print what mixing cost every log_mixer_every submitted ticks, 0 disables
+// it.
+inline constexpr int log_mixer_every = 0;
+
+// How a sound competes for voices. Starting one more than max_voices of a
+// sound replaces its oldest voice. When every voice is busy, the new sound
+// takes the oldest one of the lowest priority, unless they all outrank it.
+// Starts within min_gap_ms of the last one are dropped, they'd only sound
+// like a louder copy of it.
+struct sound_params {
+	int max_voices = 2;
+	int priority = 0;
+	float gain = 1;
+	int min_gap_ms = 30;
+};
+
+// Totals since the device was opened, as of the last audio callback.
+struct audio_stats {
+	uint64_t callbacks = 0;
+	uint64_t frames = 0;
+
+	// Time spent in the callback, in SDL_GetPerformanceCounter() ticks.
+	uint64_t mix_ticks = 0;
+	uint64_t worst_mix_ticks = 0;
+
+	uint64_t started = 0;
+	uint64_t coalesced = 0; // repeats within a callback or min_gap_ms
+	uint64_t stolen = 0; // cut off by a newer voice
+	uint64_t dropped = 0; // outranked by every playing voice
+	uint64_t overflowed = 0; // lost to a full command queue
+
+	int peak_voices = 0;
+};
+
+// Plays sounds on an SDL audio device without SDL_mixer. Clips are
+// converted to the device format once when loaded, the callback only adds
+// up samples. Plays are handed to it through a lock-free queue, so
+// submitting never waits on the audio thread and the audio thread never
+// waits on anyone.
+//
+// Clips are loaded before start(), and only one thread may submit.
+struct audio_mixer {
+	static constexpr int voices = 16;
+
+	audio_mixer(int freq = 44100, int samples = 512) {
+		if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+			std::cerr << "Failed to initialize audio: " << SDL_GetError() << "\n";
+			return;
+		}
+
+		SDL_AudioSpec want{};
+		want.freq = freq;
+		want.format = AUDIO_S16SYS;
+		want.channels = channels;
+		want.samples = samples;
+		want.userdata = this;
+		want.callback = [] (void *ctx, Uint8 *out, int len) {
+			static_cast<audio_mixer *>(ctx)->mix_(reinterpret_cast<int16_t *>(out),
+					len / sizeof(int16_t));
+		};
+
+		// Left to SDL to convert to whatever the device really wants.
+		dev_ = SDL_OpenAudioDevice(nullptr, 0, &want, &spec_, 0);
+		if (!dev_) {
+			std::cerr << "Failed to open audio device: " << SDL_GetError() << "\n";
+			spec_ = want;
+		}
+
+		mix_buf_.resize(spec_.samples * channels);
+	}
+
+	~audio_mixer() {
+		if (dev_)
+			SDL_CloseAudioDevice(dev_);
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	}
+
+	audio_mixer(const audio_mixer &) = delete;
+	audio_mixer &operator=(const audio_mixer &) = delete;
+
+	bool load(sound s, const char *path, sound_params params = {}) {
+		SDL_AudioSpec spec;
+		Uint8 *buf;
+		Uint32 len;
+		if (!SDL_LoadWAV(path, &spec, &buf, &len)) {
+			std::cerr << "Failed to load \"" << path << "\": " << SDL_GetError() << "\n";
+			return false;
+		}
+
+		SDL_AudioCVT cvt;
+		if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq,
+				AUDIO_S16SYS, channels, spec_.freq) < 0) {
+			std::cerr << "Can't convert \"" << path << "\": " << SDL_GetError() << "\n";
+			SDL_FreeWAV(buf);
+			return false;
+		}
+
+		std::vector<uint8_t> data(len * cvt.len_mult);
+		std::copy_n(buf, len, data.begin());
+		SDL_FreeWAV(buf);
+
+		cvt.buf = data.data();
+		cvt.len = len;
+		cvt.len_cvt = len;
+		if (cvt.needed)
+			SDL_ConvertAudio(&cvt);
+
+		auto &c = clips_[static_cast<size_t>(s)];
+		auto samples = reinterpret_cast<const int16_t *>(data.data());
+		c.samples.assign(samples, samples + cvt.len_cvt / sizeof(int16_t));
+		c.params = params;
+		c.gain = static_cast<int>(params.gain * 256);
+		c.min_gap = static_cast<uint64_t>(params.min_gap_ms) * spec_.freq / 1000;
+		return true;
+	}
+
+	void start() {
+		if (dev_)
+			SDL_PauseAudioDevice(dev_, 0);
+	}
+
+	void play(sound s) {
+		if (!commands_.push(s))
+			overflowed_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Plays every sound in a sound_events::take() result, once per tick.
+	void submit(uint32_t fired) {
+		for (size_t i = 0; i < clips_.size(); i++)
+			if (fired & (1u << i))
+				play(static_cast<sound>(i));
+
+		if constexpr (log_mixer_every > 0) {
+			if (++submits_ == log_mixer_every) {
+				log_stats_();
+				submits_ = 0;
+			}
+		}
+	}
+
+	// Any thread but the audio one.
+	audio_stats stats() {
+		stats_out_.acquire();
+		auto s = stats_out_.front();
+		s.overflowed = overflowed_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	static constexpr int channels = 2;
+
+	struct clip {
+		std::vector<int16_t> samples; // interleaved, in the device format
+		sound_params params;
+		int gain = 256; // 8.8 fixed point
+		uint64_t min_gap = 0; // frames
+	};
+
+	struct voice {
+		const clip *c = nullptr;
+		size_t pos = 0;
+		uint64_t started = 0;
+		sound s{};
+	};
+
+	// Audio thread from here on.
+	void mix_(int16_t *out, size_t n) {
+		auto begin = SDL_GetPerformanceCounter();
+
+		uint32_t starting = 0;
+		sound s;
+		while (commands_.pop(s)) {
+			auto bit = 1u << static_cast<int>(s);
+			if (starting & bit)
+				stats_.coalesced++;
+			starting |= bit;
+		}
+
+		for (size_t i = 0; i < clips_.size(); i++)
+			if (starting & (1u << i))
+				start_(static_cast<sound>(i));
+
+		// A callback normally asks for exactly one buffer, but may not.
+		for (size_t done = 0; done < n;) {
+			size_t chunk = std::min(n - done, mix_buf_.size());
+			mix_chunk_(out + done, chunk);
+			done += chunk;
+		}
+
+		int playing = 0;
+		for (auto &v : voices_)
+			playing += v.c != nullptr;
+
+		auto ticks = SDL_GetPerformanceCounter() - begin;
+		stats_.callbacks++;
+		stats_.frames += n / channels;
+		stats_.mix_ticks += ticks;
+		stats_.worst_mix_ticks = std::max(stats_.worst_mix_ticks, ticks);
+		stats_.peak_voices = std::max(stats_.peak_voices, playing);
+
+		stats_out_.back() = stats_;
+		stats_out_.publish();
+	}
+
+	void mix_chunk_(int16_t *out, size_t n) {
+		std::fill_n(mix_buf_.begin(), n, 0);
+
+		for (auto &v : voices_) {
+			if (!v.c)
+				continue;
+
+			auto &samples = v.c->samples;
+			size_t len = std::min(n, samples.size() - v.pos);
+			int gain = v.c->gain;
+			for (size_t i = 0; i < len; i++)
+				mix_buf_[i] += samples[v.pos + i] * gain >> 8;
+
+			v.pos += len;
+			if (v.pos == samples.size())
+				v.c = nullptr;
+		}
+
+		for (size_t i = 0; i < n; i++)
+			out[i] = std::clamp<int32_t>(mix_buf_[i], INT16_MIN, INT16_MAX);
+
+		clock_ += n / channels;
+	}
+
+	void start_(sound s) {
+		auto &c = clips_[static_cast<size_t>(s)];
+		if (c.samples.empty())
+			return;
+
+		auto &last = last_start_[static_cast<size_t>(s)];
+		if (last && clock_ < last + c.min_gap) {
+			stats_.coalesced++;
+			return;
+		}
+
+		int same = 0;
+		voice *oldest_same = nullptr, *free = nullptr, *weakest = nullptr;
+		for (auto &v : voices_) {
+			if (!v.c) {
+				if (!free)
+					free = &v;
+				continue;
+			}
+
+			if (v.s == s) {
+				same++;
+				if (!oldest_same || v.started < oldest_same->started)
+					oldest_same = &v;
+			}
+
+			if (!weakest || v.c->params.priority < weakest->c->params.priority
+					|| (v.c->params.priority == weakest->c->params.priority
+						&& v.started < weakest->started))
+				weakest = &v;
+		}
+
+		voice *slot = free;
+		if (same >= c.params.max_voices)
+			slot = oldest_same;
+		else if (!slot && weakest->c->params.priority <= c.params.priority)
+			slot = weakest;
+
+		if (!slot) {
+			stats_.dropped++;
+			return;
+		}
+
+		if (slot->c)
+			stats_.stolen++;
+
+		*slot = {&c, 0, clock_, s};
+		// Never 0, that means it hasn't played yet.
+		last = clock_ + 1;
+		stats_.started++;
+	}
+
+	void log_stats_() {
+		auto s = stats();
+		auto d = s;
+		d.callbacks -= logged_.callbacks;
+		d.frames -= logged_.frames;
+		d.mix_ticks -= logged_.mix_ticks;
+		d.started -= logged_.started;
+		d.coalesced -= logged_.coalesced;
+		d.stolen -= logged_.stolen;
+		d.dropped -= logged_.dropped;
+		d.overflowed -= logged_.overflowed;
+		logged_ = s;
+
+		if (!d.callbacks)
+			return;
+
+		double freq = SDL_GetPerformanceFrequency();
+		double audio_s = static_cast<double>(d.frames) / spec_.freq;
+		std::printf("mixer: %.1f us per callback (%.2f%% of playback time, worst %.1f us), "
+				"%llu started, %llu coalesced, %llu stolen, %llu dropped, %llu overflowed, "
+				"peak %d voices\n",
+				d.mix_ticks / freq / d.callbacks * 1e6,
+				audio_s > 0 ? d.mix_ticks / freq / audio_s * 100 : 0,
+				s.worst_mix_ticks / freq * 1e6,
+				static_cast<unsigned long long>(d.started),
+				static_cast<unsigned long long>(d.coalesced),
+				static_cast<unsigned long long>(d.stolen),
+				static_cast<unsigned long long>(d.dropped),
+				static_cast<unsigned long long>(d.overflowed),
+				s.peak_voices);
+	}
+
+	SDL_AudioDeviceID dev_ = 0;
+	SDL_AudioSpec spec_{};
+
+	std::array<clip, static_cast<size_t>(sound::count)> clips_;
+
+	spsc_queue<sound, 64> commands_;
+
+	// Submitting side.
+	std::atomic<uint64_t> overflowed_{0};
+	int submits_ = 0;
+	audio_stats logged_;
+
+	// Audio thread side.
+	std::array<voice, voices> voices_;
+	std::array<uint64_t, static_cast<size_t>(sound::count)> last_start_{};
+	std::vector<int32_t> mix_buf_;
+	uint64_t clock_ = 0; // frames mixed so far
+	audio_stats stats_;
+
+	triple_buffer<audio_stats> stats_out_;
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+#include <camera.hpp>
+#include <simd.hpp>
+
+// Uniform grid over the world that moving objects are registered into once
+// per tick. Objects outside of the world are clamped into the border cells,
+// so queries stay correct for them, just slower.
+struct broadphase {
+	static constexpr int cell_size = 16;
+	static constexpr int cells_x = world::width / cell_size + 1;
+	static constexpr int cells_y = world::height / cell_size + 1;
+
+	enum class kind : uint8_t {
+		player, enemy, bullet, powerup
+	};
+
+	struct entry {
+		double x, y, w, h;
+		kind k;
+		uint32_t id;
+	};
+
+	void clear() {
+		entries_.clear();
+		built_ = false;
+	}
+
+	void insert(kind k, uint32_t id, double x, double y, double w, double h) {
+		entries_.push_back({x, y, w, h, k, id});
+		built_ = false;
+	}
+
+	// Calls fn for every entry overlapping the rectangle, edges touching
+	// counts as overlapping.
+	template <typename F>
+	void query(double x, double y, double w, double h, F &&fn) {
+		build_();
+
+		auto stamp = ++stamp_;
+		auto [x0, y0, x1, y1] = cell_range_(x, y, w, h);
+
+		auto left = simd::splat(x), right = simd::splat(x + w);
+		auto top = simd::splat(y), bottom = simd::splat(y + h);
+
+		for (int cy = y0; cy <= y1; cy++) {
+			for (int cx = x0; cx <= x1; cx++) {
+				auto c = cy * cells_x + cx;
+
+				// The bounds are padded, so whole vectors can be loaded past
+				// the end of a cell.
+				simd::for_each(cell_start_[c], cell_start_[c + 1], [&] (size_t i, size_t n) {
+					auto hits = simd::bits((simd::load(&left_[i]) <= right)
+							& (simd::load(&right_[i]) >= left)
+							& (simd::load(&top_[i]) <= bottom)
+							& (simd::load(&bottom_[i]) >= top));
+
+					for (hits &= (1u << n) - 1; hits; hits &= hits - 1) {
+						auto idx = items_[i + std::countr_zero(hits)];
+						if (visited_[idx] == stamp)
+							continue;
+						visited_[idx] = stamp;
+
+						fn(entries_[idx]);
+					}
+				});
+			}
+		}
+	}
+
+	// Calls fn(a, b) for every overlapping pair where a is of kind ka and b
+	// is of kind kb.
+	template <typename F>
+	void pairs(kind ka, kind kb, F &&fn) {
+		build_();
+
+		for (size_t i = 0; i < entries_.size(); i++) {
+			if (entries_[i].k != ka)
+				continue;
+
+			auto a = entries_[i];
+			query(a.x, a.y, a.w, a.h, [&] (const entry &b) {
+				if (b.k == kb && (ka != kb || b.id != a.id))
+					fn(a, b);
+			});
+		}
+	}
+
+	size_t size() const {
+		return entries_.size();
+	}
+
+private:
+	struct range {
+		int x0, y0, x1, y1;
+	};
+
+	static int cell_of_(double v, int n) {
+		return std::clamp(static_cast<int>(std::floor(v / cell_size)), 0, n - 1);
+	}
+
+	static range cell_range_(double x, double y, double w, double h) {
+		return {
+			cell_of_(x, cells_x), cell_of_(y, cells_y),
+			cell_of_(x + w, cells_x), cell_of_(y + h, cells_y)
+		};
+	}
+
+	// Counting sort of entries into cells, entries spanning several cells
+	// are listed in each of them.
+	void build_() {
+		if (built_)
+			return;
+
+		cell_start_.assign(cells_x * cells_y + 1, 0);
+		for (auto &e : entries_) {
+			auto [x0, y0, x1, y1] = cell_range_(e.x, e.y, e.w, e.h);
+			for (int cy = y0; cy <= y1; cy++)
+				for (int cx = x0; cx <= x1; cx++)
+					cell_start_[cy * cells_x + cx + 1]++;
+		}
+
+		for (size_t c = 1; c < cell_start_.size(); c++)
+			cell_start_[c] += cell_start_[c - 1];
+
+		items_.resize(cell_start_.back());
+		cursor_.assign(cell_start_.begin(), cell_start_.end() - 1);
+
+		for (auto v : {&left_, &right_, &top_, &bottom_})
+			v->assign(items_.size() + simd::lanes, 0);
+
+		for (uint32_t i = 0; i < entries_.size(); i++) {
+			auto &e = entries_[i];
+			auto [x0, y0, x1, y1] = cell_range_(e.x, e.y, e.w, e.h);
+			for (int cy = y0; cy <= y1; cy++) {
+				for (int cx = x0; cx <= x1; cx++) {
+					auto j = cursor_[cy * cells_x + cx]++;
+					items_[j] = i;
+					left_[j] = e.x;
+					right_[j] = e.x + e.w;
+					top_[j] = e.y;
+					bottom_[j] = e.y + e.h;
+				}
+			}
+		}
+
+		visited_.assign(entries_.size(), 0);
+		stamp_ = 0;
+		built_ = true;
+	}
+
+	std::vector<entry> entries_;
+
+	std::vector<uint32_t> cell_start_;
+	std::vector<uint32_t> cursor_;
+	std::vector<uint32_t> items_;
+
+	// Bounds of the entries in items_, in the same order.
+	std::vector<float> left_, right_, top_, bottom_;
+
+	std::vector<uint32_t> visited_;
+	uint32_t stamp_ = 0;
+	bool built_ = false;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <screen.hpp>
+#include <snapshot.hpp>
+
+// How many screens wide and tall the playfield is. The game is balanced
+// for one, a bigger arena needs its spawn rates and layout retuned too.
+inline constexpr int world_screens = 1;
+
+// The playfield, independent of how much of it fits on the screen.
+struct world {
+	static constexpr int width = screen::width * world_screens;
+	static constexpr int height = screen::height * world_screens;
+};
+
+struct camera {
+	// Centers the view on the given point without leaving the world.
+	void follow(double tx, double ty) {
+		x_ = std::clamp(static_cast<int>(tx) - screen::width / 2, 0, world::width - screen::width);
+		y_ = std::clamp(static_cast<int>(ty) - screen::height / 2, 0, world::height - screen::height);
+	}
+
+	glm::mat4 transform() const {
+		return glm::ortho(static_cast<float>(x_), static_cast<float>(x_ + screen::width),
+				static_cast<float>(y_ + screen::height), static_cast<float>(y_));
+	}
+
+	bool visible(double ox, double oy, double ow, double oh) const {
+		return ox < x_ + screen::width && ox + ow > x_
+			&& oy < y_ + screen::height && oy + oh > y_;
+	}
+
+	int x() const { return x_; }
+	int y() const { return y_; }
+
+	void save(snapshot_writer &w) const {
+		w.put(x_);
+		w.put(y_);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(x_);
+		r.get(y_);
+	}
+
+private:
+	int x_ = 0, y_ = 0;
+};
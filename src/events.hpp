@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <stdint.h>
+#include <jobs.hpp>
+#include <sound.hpp>
+
+// Side effects of a tick on somebody other than whoever caused them.
+// Subsystems append these while the tick graph runs, the simulation applies
+// all of them once it has finished.
+enum class event_kind : uint8_t {
+	damage, // the player loses n health
+	heal, // the player gains n health
+	power_up, // everything slows down for a while
+	shoot, // a bullet flies off from x, y at n pixels per second
+	particles, // n particles burst out of x, y
+	sound, // play s
+	count
+};
+
+// Which stage of the tick an event came from.
+enum class event_source : uint8_t {
+	blocks, player, enemies, bullets, powerups,
+	count
+};
+
+struct game_event {
+	event_kind kind;
+	event_source from;
+	sound s = sound::count;
+	int n = 0;
+	float x = 0, y = 0;
+};
+
+// One buffer per job system slot, so pushing never contends. take() hands
+// out everything pushed so far sorted by kind and then by source, so that
+// consumers get runs of one kind and the outcome doesn't depend on which
+// thread got which job. Events from one job keep the order they were
+// pushed in, those of a parallel-for don't. Sorting is a counting sort, it
+// doesn't allocate once out has grown.
+struct event_stream {
+	explicit event_stream(size_t slots)
+	: buffers_(slots) { }
+
+	void push(const game_event &ev) {
+		buffers_[job_system::current_slot()].events.push_back(ev);
+	}
+
+	// Only while no job is running. The buffers keep their capacity.
+	void take(std::vector<game_event> &out) {
+		std::array<size_t, keys + 1> start{};
+		for (auto &b : buffers_)
+			for (auto &ev : b.events)
+				start[key_(ev) + 1]++;
+
+		for (size_t i = 0; i < keys; i++)
+			start[i + 1] += start[i];
+
+		out.resize(start[keys]);
+		for (auto &b : buffers_) {
+			for (auto &ev : b.events)
+				out[start[key_(ev)]++] = ev;
+			b.events.clear();
+		}
+	}
+
+private:
+	static constexpr size_t sources = static_cast<size_t>(event_source::count);
+	static constexpr size_t keys = static_cast<size_t>(event_kind::count) * sources;
+
+	static size_t key_(const game_event &ev) {
+		return static_cast<size_t>(ev.kind) * sources + static_cast<size_t>(ev.from);
+	}
+
+	// Kept apart so that slots pushing at once don't share a cache line.
+	struct alignas(64) buffer {
+		std::vector<game_event> events;
+	};
+
+	std::vector<buffer> buffers_;
+};
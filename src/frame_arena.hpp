@@ -0,0 +1,112 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <stdint.h>
+
+// Bump allocator for data that only lives until the end of the frame. Freeing
+// is a no-op, everything is released at once by reset(). When a frame needs
+// more than the buffer holds, the rest comes from the upstream resource and
+// the buffer is grown to fit on the next reset, so it settles after a few
+// frames. Not thread-safe, only the main thread may use it.
+struct frame_arena final : std::pmr::memory_resource {
+	explicit frame_arena(size_t capacity,
+			std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+	: upstream_{upstream} {
+		grow_(capacity);
+	}
+
+	~frame_arena() {
+		release_overflow_();
+		upstream_->deallocate(buffer_, capacity_, alignof(std::max_align_t));
+	}
+
+	frame_arena(const frame_arena &) = delete;
+	frame_arena &operator=(const frame_arena &) = delete;
+
+	void reset() {
+		if (overflow_) {
+			release_overflow_();
+			grow_(std::bit_ceil(demand_));
+		}
+
+		used_ = 0;
+		demand_ = 0;
+	}
+
+	size_t capacity() const {
+		return capacity_;
+	}
+
+	// Bytes handed out since the last reset, overflow included.
+	size_t used() const {
+		return demand_;
+	}
+
+private:
+	struct overflow_block {
+		overflow_block *next;
+		size_t size;
+	};
+
+	void *do_allocate(size_t bytes, size_t align) override {
+		demand_ += bytes;
+
+		auto base = reinterpret_cast<uintptr_t>(buffer_);
+		auto offset = ((base + used_ + align - 1) & ~(align - 1)) - base;
+		if (offset + bytes <= capacity_) {
+			used_ = offset + bytes;
+			return buffer_ + offset;
+		}
+
+		// Room for the header and for aligning the payload behind it.
+		auto size = sizeof(overflow_block) + align + bytes;
+		auto block = static_cast<overflow_block *>(
+				upstream_->allocate(size, alignof(std::max_align_t)));
+		*block = {overflow_, size};
+		overflow_ = block;
+
+		auto payload = reinterpret_cast<uintptr_t>(block + 1);
+		return reinterpret_cast<void *>((payload + align - 1) & ~(align - 1));
+	}
+
+	void do_deallocate(void *, size_t, size_t) override { }
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		return this == &other;
+	}
+
+	void grow_(size_t capacity) {
+		if (buffer_)
+			upstream_->deallocate(buffer_, capacity_, alignof(std::max_align_t));
+
+		capacity_ = capacity;
+		buffer_ = static_cast<std::byte *>(upstream_->allocate(capacity_, alignof(std::max_align_t)));
+	}
+
+	void release_overflow_() {
+		while (overflow_) {
+			auto next = overflow_->next;
+			upstream_->deallocate(overflow_, overflow_->size, alignof(std::max_align_t));
+			overflow_ = next;
+		}
+	}
+
+	std::pmr::memory_resource *upstream_;
+
+	std::byte *buffer_ = nullptr;
+	size_t capacity_ = 0;
+	size_t used_ = 0;
+	size_t demand_ = 0;
+
+	overflow_block *overflow_ = nullptr;
+};
+
+// The arena for the current frame, reset at the start of window::main_loop.
+inline frame_arena &frame_memory() {
+	static frame_arena arena{64 * 1024};
+	return arena;
+}
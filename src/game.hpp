@@ -0,0 +1,2075 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <bitset>
+#include <cmath>
+#include <charconv>
+#include <memory_resource>
+
+#include <glm/glm.hpp>
+
+#include <gl/shader.hpp>
+#include <gl/mesh.hpp>
+#include <gl/texture.hpp>
+
+#include <sprite.hpp>
+#include <text.hpp>
+#include <render_queue.hpp>
+#include <retained_layer.hpp>
+#include <rewind.hpp>
+#include <triple_buffer.hpp>
+#include <snapshot.hpp>
+#include <time.hpp>
+#include <jobs.hpp>
+#include <camera.hpp>
+#include <broadphase.hpp>
+#include <random.hpp>
+#include <simd.hpp>
+#include <frame_arena.hpp>
+#include <screen.hpp>
+#include <input.hpp>
+
+#include <sound.hpp>
+#include <events.hpp>
+#include <quality.hpp>
+#include <audio.hpp>
+
+template <int N>
+struct clouds {
+	clouds(const sprite_sheet &sheet, time_tracker &tt, rng r)
+	: spr_{sheet},
+			alarm_{tt.add_alarm(0.07)}, rng_{r} {
+		for (auto &c : pos_) {
+			c.x = rng_.range(0, world::width);
+			c.y = rng_.range(0, world::height - 16);
+		}
+	}
+
+	// Returns whether the clouds moved.
+	bool tick() {
+		if (!alarm_.expired())
+			return false;
+
+		alarm_.rearm();
+		for (auto &c : pos_) {
+			c.x += 1;
+
+			if (c.x >= world::width) {
+				c.x = -64;
+				c.y = rng_.range(0, world::height - 16);
+			}
+		}
+
+		return true;
+	}
+
+	void render(draw_list &list, size_t count = N) {
+		for (size_t i = 0; i < std::min(count, pos_.size()); i++) {
+			spr_.x = pos_[i].x;
+			spr_.y = pos_[i].y;
+			spr_.render(list, layer::clouds);
+		}
+	}
+
+	// The alarm is saved along with the time tracker.
+	void save(snapshot_writer &w) const {
+		w.put(pos_);
+		w.put(rng_);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(pos_);
+		r.get(rng_);
+	}
+private:
+	std::array<glm::vec2, N> pos_{};
+	sprite spr_;
+	alarm &alarm_;
+	rng rng_;
+};
+
+struct particles {
+	particles(const sprite_sheet &sheet, rng r)
+	: spr_{sheet}, rng_{r} { }
+
+	void add_particle(double x, double y) {
+		x_.push_back(x);
+		y_.push_back(y);
+		xvel_.push_back(rng_.uniform(0, 3) * 50);
+		yvel_.push_back(rng_.uniform(-4, -1) * 50);
+		xdir_.push_back(rng_.range(0, 1) ? 1 : -1);
+	}
+
+	void tick(double delta) {
+		integrate(0, size(), delta);
+		cull();
+	}
+
+	// Only touches particles in [begin, end), so disjoint ranges can be
+	// integrated concurrently.
+	void integrate(size_t begin, size_t end, double delta) {
+		auto d = simd::splat(delta);
+		auto zero = simd::splat(0);
+
+		simd::for_each(begin, end, [&] (size_t i, size_t n) {
+			auto x = simd::load(&x_[i], n), y = simd::load(&y_[i], n);
+			auto xvel = simd::load(&xvel_[i], n), yvel = simd::load(&yvel_[i], n);
+
+			x += xvel * simd::load(&xdir_[i], n) * d;
+			xvel = simd::select(xvel > zero, xvel - simd::splat(20), zero);
+			y += yvel * d;
+			yvel += simd::splat(50);
+
+			simd::store(&x_[i], x, n);
+			simd::store(&y_[i], y, n);
+			simd::store(&xvel_[i], xvel, n);
+			simd::store(&yvel_[i], yvel, n);
+		});
+	}
+
+	void cull() {
+		auto bottom = simd::splat(world::height);
+
+		auto n = simd::compact(size(),
+			[&] (size_t i, size_t n) {
+				return simd::bits(simd::load(&y_[i], n) >= bottom);
+			},
+			[&] (size_t from, size_t to) {
+				for (auto v : {&x_, &y_, &xvel_, &yvel_, &xdir_})
+					(*v)[to] = (*v)[from];
+			});
+
+		for (auto v : {&x_, &y_, &xvel_, &yvel_, &xdir_})
+			v->resize(n);
+	}
+
+	size_t size() const {
+		return x_.size();
+	}
+
+	void render(draw_list &list) {
+		for (size_t i = 0; i < size(); i++) {
+			spr_.x = x_[i];
+			spr_.y = y_[i];
+			spr_.render(list, layer::particles);
+		}
+	}
+
+	void clear() {
+		for (auto v : {&x_, &y_, &xvel_, &yvel_, &xdir_})
+			v->clear();
+	}
+
+	void save(snapshot_writer &w) const {
+		w.put(rng_);
+		for (auto v : {&x_, &y_, &xvel_, &yvel_, &xdir_})
+			w.put_vector(*v);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(rng_);
+		for (auto v : {&x_, &y_, &xvel_, &yvel_, &xdir_})
+			r.get_vector(*v);
+	}
+
+private:
+	sprite spr_;
+	rng rng_;
+
+	// One array per field, xdir is either 1 or -1.
+	std::vector<float> x_, y_;
+	std::vector<float> xvel_, yvel_;
+	std::vector<float> xdir_;
+};
+
+struct blocks {
+	static constexpr int cols = world::width / 8;
+	static constexpr int rows = world::height / 8;
+
+	static constexpr int min_platform = 4;
+	static constexpr int max_platform = 8;
+
+	blocks(const sprite_sheet &sheet, event_stream &events, rng r)
+	: sheet_{sheet}, events_{events}, rng_{r} {
+		for (int y = 0; y < rows; y++)
+			update_spans_(y);
+	}
+
+private:
+	// Where random platforms may go, in cells.
+	static constexpr int first_platform_col = 2;
+	static constexpr int first_platform_row = 4;
+	static constexpr int last_platform_row = rows - 3;
+
+	static constexpr double pop_in_time = 0.08;
+	static constexpr double shake_time = 0.2;
+
+	// Blocks pop in, stay solid for a while, shake and fall out of the world.
+	// Each stage has its own bucket, solid blocks sit in theirs untouched
+	// until their expiry comes up.
+	struct block {
+		block(const sprite_sheet &sheet, glm::ivec2 cell, int frame, double time_left)
+		: spr{sheet, frame + 24}, cell{cell}, frame{frame}, time_left{time_left},
+			x{cell.x * 8.}, y{cell.y * 8.} { }
+
+		void render(draw_list &list) {
+			spr.x = x + xoff;
+			spr.y = y + yoff;
+			spr.render(list, layer::blocks);
+		}
+
+		sprite spr;
+		glm::ivec2 cell;
+		int frame;
+
+		double time_left; // how long it stays solid
+		double timer = pop_in_time; // remaining time in the current stage
+		double time_particle = 0;
+		double x, y;
+		int xoff = 0, yoff = 0;
+	};
+
+	struct expiry {
+		double at;
+		glm::ivec2 cell;
+
+		bool operator>(const expiry &other) const {
+			return at > other.at;
+		}
+	};
+
+public:
+	void tick(double delta) {
+		now_ += delta;
+
+		for (size_t i = 0; i < popping_.size();) {
+			auto &bl = popping_[i];
+			bl.timer -= delta;
+			if (bl.timer > 0) {
+				bl.spr.set_frame(bl.frame + (bl.timer > pop_in_time / 2 ? 24 : 48));
+				i++;
+				continue;
+			}
+
+			auto solid = take_(popping_, i);
+			solid.spr.set_frame(solid.frame);
+			expiries_.push_back({now_ + solid.time_left, solid.cell});
+			std::push_heap(expiries_.begin(), expiries_.end(), std::greater<>{});
+			solid_slot_[solid.cell.y][solid.cell.x] = solid_.size();
+			solid_.push_back(std::move(solid));
+		}
+
+		while (!expiries_.empty() && expiries_.front().at <= now_) {
+			std::pop_heap(expiries_.begin(), expiries_.end(), std::greater<>{});
+			auto cell = expiries_.back().cell;
+			expiries_.pop_back();
+
+			auto shaking = take_solid_(cell);
+			shaking.timer = shake_time;
+			shaking_.push_back(std::move(shaking));
+		}
+
+		for (size_t i = 0; i < shaking_.size();) {
+			auto &bl = shaking_[i];
+			bl.xoff = rng_.range(-1, 1);
+			bl.yoff = rng_.range(-1, 1);
+
+			bl.time_particle -= delta;
+			if (bl.time_particle <= 0) {
+				events_.push({.kind = event_kind::particles, .from = event_source::blocks,
+					.n = 4, .x = static_cast<float>(bl.x + 4),
+					.y = static_cast<float>(bl.y + 8)});
+				bl.time_particle = 0.05;
+			}
+
+			bl.timer -= delta;
+			if (bl.timer > 0) {
+				i++;
+				continue;
+			}
+
+			auto falling = take_(shaking_, i);
+			collidable_[falling.cell.y][falling.cell.x] = false;
+			events_.push({.kind = event_kind::sound, .from = event_source::blocks,
+				.s = sound::blockfall});
+			falling_.push(falling.cell, falling.spr.get_frame(), falling.y);
+		}
+
+		auto d = simd::splat(delta);
+		simd::for_each(0, falling_.size(), [&] (size_t i, size_t n) {
+			auto y = simd::load(&falling_.y[i], n);
+			auto yvel = simd::load(&falling_.yvel[i], n);
+			y += yvel * d;
+			yvel += simd::splat(10);
+			simd::store(&falling_.y[i], y, n);
+			simd::store(&falling_.yvel[i], yvel, n);
+		});
+
+		auto bottom = simd::splat(world::height);
+		auto n = simd::compact(falling_.size(),
+			[&] (size_t i, size_t n) {
+				auto gone = simd::bits(simd::load(&falling_.y[i], n) >= bottom);
+
+				// Only now can the cells be reused.
+				for (auto b = gone & ((1u << n) - 1); b; b &= b - 1) {
+					auto cell = falling_.cell[i + std::countr_zero(b)];
+					occupied_[cell.y][cell.x] = false;
+					update_spans_(cell.y);
+				}
+
+				return gone;
+			},
+			[&] (size_t from, size_t to) {
+				falling_.move(from, to);
+			});
+		falling_.resize(n);
+	}
+
+	// Picks a random free span, only the dynamic objects are left for check
+	// to reject.
+	template <typename F>
+	void add_platform(F &&check) {
+		for (int tries = 0; tries < 4; tries++) {
+			auto len = rng_.range(min_platform, max_platform);
+			auto &spans = spans_[len - min_platform];
+			if (!spans.total)
+				continue;
+
+			auto k = static_cast<uint32_t>(rng_.range(0, spans.total - 1));
+
+			int yy = first_platform_row;
+			while (k >= spans.count[yy])
+				k -= spans.count[yy++];
+
+			auto starts = spans.starts[yy].to_ullong();
+			while (k--)
+				starts &= starts - 1;
+			int xx = std::countr_zero(starts);
+
+			if (!check(xx, yy, len)) continue;
+
+			add_platform_at(xx, yy, len);
+
+			break;
+		}
+	}
+
+	void add_platform_at(int x, int y, int len) {
+		for (int i = 0; i < len; i++) {
+			int frame = rng_.range(0, 23);
+			popping_.emplace_back(sheet_, glm::ivec2{x + i, y}, frame, rng_.uniform(8., 12.));
+			occupied_[y][x + i] = true;
+			collidable_[y][x + i] = true;
+		}
+
+		update_spans_(y);
+	}
+
+	void render(draw_list &list) {
+		for (auto bucket : {&popping_, &solid_, &shaking_})
+			for (auto &bl : *bucket)
+				bl.render(list);
+
+		for (size_t i = 0; i < falling_.size(); i++)
+			list.add(sheet_, layer::blocks, falling_.frame[i],
+					falling_.cell[i].x * 8, falling_.y[i], {1, 1, 1, 1}, 0);
+	}
+
+	// Whether the rectangle overlaps any block that isn't falling, edges
+	// touching included. Only looks at the cells the rectangle covers.
+	bool check_collision(double x, double y, double w, double h) const {
+		int c0 = std::max(static_cast<int>(std::ceil((x - 8) / 8)), 0);
+		int c1 = std::min(static_cast<int>(std::floor((x + w) / 8)), cols - 1);
+		int r0 = std::max(static_cast<int>(std::ceil((y - 8) / 8)), 0);
+		int r1 = std::min(static_cast<int>(std::floor((y + h) / 8)), rows - 1);
+
+		for (int r = r0; r <= r1; r++)
+			for (int c = c0; c <= c1; c++)
+				if (collidable_[r][c])
+					return true;
+
+		return false;
+	}
+
+	// What a 7x7 walker at (x, y) sees, dir is -1 for left and 1 for right.
+	bool wall_ahead(double x, double y, int dir) const {
+		return check_collision(x + 4 * dir, y, 7, 7);
+	}
+
+	bool ground_ahead(double x, double y, int dir) const {
+		return check_collision(x + 4 * dir, y + 4, 7, 7);
+	}
+
+	bool grounded(double x, double y) const {
+		return check_collision(x, y + 4, 7, 7);
+	}
+
+	bool block_at(int x, int y) const {
+		return x >= 0 && x < cols && y >= 0 && y < rows && occupied_[y][x];
+	}
+
+	bool solid_at(int x, int y) const {
+		return x >= 0 && x < cols && y >= 0 && y < rows && collidable_[y][x];
+	}
+
+	size_t size() const {
+		return popping_.size() + solid_.size() + shaking_.size() + falling_.size();
+	}
+
+	void clear() {
+		popping_.clear();
+		solid_.clear();
+		shaking_.clear();
+		falling_.resize(0);
+		expiries_.clear();
+		occupied_ = {};
+		collidable_ = {};
+
+		for (int y = 0; y < rows; y++)
+			update_spans_(y);
+	}
+
+	// Only the buckets and the expiry heap are saved, the cell maps are
+	// derived from them.
+	void save(snapshot_writer &w) const {
+		w.put(rng_);
+		w.put(now_);
+
+		for (auto bucket : {&popping_, &solid_, &shaking_}) {
+			w.put(static_cast<uint32_t>(bucket->size()));
+			for (auto &bl : *bucket) {
+				w.put(bl.cell);
+				w.put(bl.frame);
+				w.put(bl.spr.get_frame());
+				w.put(bl.time_left);
+				w.put(bl.timer);
+				w.put(bl.time_particle);
+				w.put(bl.x);
+				w.put(bl.y);
+				w.put(bl.xoff);
+				w.put(bl.yoff);
+			}
+		}
+
+		w.put_vector(falling_.cell);
+		w.put_vector(falling_.frame);
+		w.put_vector(falling_.y);
+		w.put_vector(falling_.yvel);
+
+		w.put_vector(expiries_);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(rng_);
+		r.get(now_);
+
+		occupied_ = {};
+		collidable_ = {};
+
+		for (auto bucket : {&popping_, &solid_, &shaking_}) {
+			bucket->clear();
+
+			auto n = r.get<uint32_t>();
+			for (uint32_t i = 0; i < n && !r.failed(); i++) {
+				auto cell = r.get<glm::ivec2>();
+				auto frame = r.get<int>();
+				auto &bl = bucket->emplace_back(sheet_, cell, frame, 0);
+				bl.spr.set_frame(r.get<int>());
+				r.get(bl.time_left);
+				r.get(bl.timer);
+				r.get(bl.time_particle);
+				r.get(bl.x);
+				r.get(bl.y);
+				r.get(bl.xoff);
+				r.get(bl.yoff);
+
+				occupied_[cell.y][cell.x] = true;
+				collidable_[cell.y][cell.x] = true;
+			}
+		}
+
+		r.get_vector(falling_.cell);
+		r.get_vector(falling_.frame);
+		r.get_vector(falling_.y);
+		r.get_vector(falling_.yvel);
+		falling_.resize(falling_.cell.size());
+
+		for (auto cell : falling_.cell)
+			occupied_[cell.y][cell.x] = true;
+
+		for (size_t i = 0; i < solid_.size(); i++)
+			solid_slot_[solid_[i].cell.y][solid_[i].cell.x] = i;
+
+		r.get_vector(expiries_);
+
+		for (int y = 0; y < rows; y++)
+			update_spans_(y);
+	}
+
+private:
+	// Swap-and-pop, the order within a bucket doesn't matter.
+	static block take_(std::vector<block> &bucket, size_t i) {
+		auto bl = std::move(bucket[i]);
+		if (i != bucket.size() - 1)
+			bucket[i] = std::move(bucket.back());
+		bucket.pop_back();
+		return bl;
+	}
+
+	// Recomputes where in the row a platform of every length would fit.
+	void update_spans_(int y) {
+		bool allowed = y >= first_platform_row && y <= last_platform_row;
+		auto fits = ~occupied_[y];
+
+		for (int len = min_platform; len <= max_platform; len++) {
+			auto &spans = spans_[len - min_platform];
+
+			// fits has bit x set when [x, x + len) is free.
+			if (len == min_platform) {
+				for (int i = 1; i < len; i++)
+					fits &= ~occupied_[y] >> i;
+			} else {
+				fits &= ~occupied_[y] >> (len - 1);
+			}
+
+			std::bitset<cols> starts;
+			if (allowed)
+				for (int x = first_platform_col; x <= cols - len - 1; x++)
+					starts[x] = fits[x];
+
+			spans.total -= spans.count[y];
+			spans.count[y] = starts.count();
+			spans.total += spans.count[y];
+			spans.starts[y] = starts;
+		}
+	}
+
+	block take_solid_(glm::ivec2 cell) {
+		auto i = solid_slot_[cell.y][cell.x];
+		if (i != solid_.size() - 1) {
+			auto moved = solid_.back().cell;
+			solid_slot_[moved.y][moved.x] = i;
+		}
+		return take_(solid_, i);
+	}
+
+	const sprite_sheet &sheet_;
+	event_stream &events_;
+	rng rng_;
+
+	double now_ = 0;
+
+	std::vector<block> popping_;
+	std::vector<block> solid_;
+	std::vector<block> shaking_;
+
+	// Falling blocks are only moved and drawn, they're kept as one array
+	// per field so they can be moved a few at a time.
+	struct falling_blocks {
+		std::vector<glm::ivec2> cell;
+		std::vector<int> frame;
+		std::vector<float> y, yvel;
+
+		void push(glm::ivec2 c, int f, float top) {
+			cell.push_back(c);
+			frame.push_back(f);
+			y.push_back(top);
+			yvel.push_back(0);
+		}
+
+		void move(size_t from, size_t to) {
+			cell[to] = cell[from];
+			frame[to] = frame[from];
+			y[to] = y[from];
+			yvel[to] = yvel[from];
+		}
+
+		void resize(size_t n) {
+			cell.resize(n);
+			frame.resize(n);
+			y.resize(n);
+			yvel.resize(n);
+		}
+
+		size_t size() const {
+			return cell.size();
+		}
+	} falling_;
+
+	// Min-heap on the expiry time.
+	std::vector<expiry> expiries_;
+	std::array<std::array<uint16_t, cols>, rows> solid_slot_{};
+
+	// Cells holding a block, falling ones included until they're gone.
+	std::array<std::bitset<cols>, rows> occupied_{};
+	// Cells holding a block that can be collided with.
+	std::array<std::bitset<cols>, rows> collidable_{};
+
+	// Valid platform positions of one length, per row.
+	struct span_index {
+		std::array<std::bitset<cols>, rows> starts{};
+		std::array<uint32_t, rows> count{};
+		uint32_t total = 0;
+	};
+
+	std::array<span_index, max_platform - min_platform + 1> spans_{};
+};
+
+struct movement {
+	bool left;
+	bool right;
+	bool jump;
+};
+
+struct entity {
+	entity(blocks &blocks, const sprite_sheet &sheet, event_stream &events,
+			event_source source, int base_frame, double xspeed)
+	: xspeed_{xspeed}, base_frame_{base_frame}, blocks_{blocks}, events_{events},
+		source_{source}, spr_{sheet, base_frame} { }
+
+	virtual ~entity() = default;
+
+	entity(const entity &) = delete;
+	entity(entity &&) = default;
+
+	virtual movement get_current_movement(double delta, const input_state &input) = 0;
+
+	void tick(double delta, const input_state &input) {
+		auto mov = get_current_movement(delta, input);
+		if (mov.left) {
+			spr_.set_frame(spr_.get_frame() | 1);
+			xdir = -1;
+			xvel = xspeed_;
+		}
+
+		if (mov.right) {
+			spr_.set_frame(spr_.get_frame() & ~1);
+			xdir = 1;
+			xvel = xspeed_;
+		}
+
+		if (mov.jump && jump_ctr) {
+			if (xdir == -1)
+				spr_.set_frame(base_frame_ + 9);
+			if (xdir == 1)
+				spr_.set_frame(base_frame_ + 8);
+			yvel = -240;
+			jump_ctr--;
+			jump_frame_wait = 10;
+			events_.push({.kind = event_kind::sound, .from = source_, .s = sound::jump});
+		}
+
+		constexpr double steps = 50;
+		for (int i = 0; i < steps; i++) {
+			auto newx = x + (xvel * xdir * delta) / steps;
+			auto newy = y + (yvel * delta) / steps;
+
+			if (!blocks_.check_collision(x, newy, 7, 7)) {
+				y = newy;
+				if ((yvel > 0 || yvel < 0) && !jump_frame_wait) {
+					if (xdir == -1)
+						spr_.set_frame(base_frame_ + 17);
+					if (xdir == 1)
+						spr_.set_frame(base_frame_ + 16);
+				}
+			} else {
+				if (yvel > 0) {
+					jump_ctr = 2;
+					if (xdir == -1)
+						spr_.set_frame(base_frame_ + 1);
+					if (xdir == 1)
+						spr_.set_frame(base_frame_ + 0);
+					jump_frame_wait = 0;
+				}
+				yvel = 0;
+			}
+
+			if (!blocks_.check_collision(newx, y, 7, 7)) {
+				x = newx;
+			} else {
+				xvel = 0;
+			}
+		}
+
+		if (xvel > 0) {
+			xvel -= 10;
+		} else {
+			xvel = 0;
+		}
+
+		yvel += 10;
+
+		if (jump_frame_wait) jump_frame_wait--;
+	}
+
+	void render(draw_list &list) {
+		spr_.x = x;
+		spr_.y = y;
+		spr_.render(list, layer::entities);
+	}
+
+	double get_x() const { return x; }
+	double get_y() const { return y; }
+
+	void set_position(double x, double y) {
+		this->x = x; this->y = y;
+	}
+
+	void reset_vel() {
+		xvel = 0;
+		yvel = 0;
+		xdir = 1;
+	}
+
+	void set_palette(uint8_t palette) {
+		spr_.palette = palette;
+	}
+
+	void save(snapshot_writer &w) const {
+		w.put(x);
+		w.put(y);
+		w.put(xvel);
+		w.put(yvel);
+		w.put(xdir);
+		w.put(jump_ctr);
+		w.put(jump_frame_wait);
+		w.put(spr_.get_frame());
+		w.put(spr_.palette);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(x);
+		r.get(y);
+		r.get(xvel);
+		r.get(yvel);
+		r.get(xdir);
+		r.get(jump_ctr);
+		r.get(jump_frame_wait);
+		spr_.set_frame(r.get<int>());
+		r.get(spr_.palette);
+	}
+
+private:
+	double xspeed_;
+	int base_frame_;
+	blocks &blocks_;
+	event_stream &events_;
+	event_source source_;
+	sprite spr_;
+	double x = 0, y = 0;
+	double xvel = 0, yvel = 0;
+	int xdir = 1;
+	int jump_ctr = 2;
+	int jump_frame_wait = 0;
+};
+
+struct player : entity {
+	player(blocks &blocks, const sprite_sheet &sheet, event_stream &events)
+	: entity{blocks, sheet, events, event_source::player, 0, 130} { }
+
+	virtual ~player() = default;
+
+	movement get_current_movement(double, const input_state &input) override {
+		return {
+			input.down(SDL_SCANCODE_LEFT),
+			input.down(SDL_SCANCODE_RIGHT),
+			input.pressed(SDL_SCANCODE_UP)
+		};
+	}
+};
+
+struct enemy : entity {
+	enemy(blocks &blocks, const sprite_sheet &sheet, event_stream &events)
+	: entity{blocks, sheet, events, event_source::enemies, 2, 80}, blocks_{blocks} { }
+
+	enemy(const enemy &) = delete;
+	enemy(enemy &&) = default;
+
+	virtual ~enemy() = default;
+
+	movement get_current_movement(double delta, const input_state &) override {
+		if (dir == 1 && blocks_.wall_ahead(get_x(), get_y(), 1))
+			dir = -dir;
+
+		if (dir == 1 && !blocks_.ground_ahead(get_x(), get_y(), 1)) {
+			dir = -dir;
+			cooldown_ = 0.3;
+			wants_shoot_ = true;
+		}
+
+		if (dir == -1 && blocks_.wall_ahead(get_x(), get_y(), -1))
+			dir = -dir;
+
+		if (dir == -1 && !blocks_.ground_ahead(get_x(), get_y(), -1)) {
+			dir = -dir;
+			cooldown_ = 0.3;
+			wants_shoot_ = true;
+		}
+
+		bool left = dir == -1, right = dir == 1;
+		if (!blocks_.grounded(get_x(), get_y()))
+			wants_shoot_ = left = right = false;
+
+		if (cooldown_ > 0 && wants_shoot_)
+			cooldown_ -= delta;
+		else if (cooldown_ <= 0 && wants_shoot_) {
+			cooldown_ = 0;
+			do_shoot_ = true;
+			wants_shoot_ = false;
+		}
+
+		time_to_live_ -= delta;
+
+		return {left, right, false};
+	}
+
+	bool wants_shoot() {
+		return std::exchange(do_shoot_, false);
+	}
+
+	int facing() const {
+		return -dir;
+	}
+
+	bool explode() {
+		return time_to_live_ <= 0;
+	}
+
+	void save(snapshot_writer &w) const {
+		entity::save(w);
+		w.put(dir);
+		w.put(wants_shoot_);
+		w.put(do_shoot_);
+		w.put(cooldown_);
+		w.put(time_to_live_);
+	}
+
+	void load(snapshot_reader &r) {
+		entity::load(r);
+		r.get(dir);
+		r.get(wants_shoot_);
+		r.get(do_shoot_);
+		r.get(cooldown_);
+		r.get(time_to_live_);
+	}
+
+private:
+	blocks &blocks_;
+	int dir = 1;
+	bool wants_shoot_ = false;
+	bool do_shoot_ = false;
+	double cooldown_ = 0;
+	double time_to_live_ = 6;
+};
+
+struct bullets {
+	bullets(blocks &blocks, const sprite_sheet &sheet, event_stream &events)
+	: blocks_{blocks}, events_{events}, spr_{sheet} { }
+
+	// Bullets that leave the world or hit a block are only flagged here,
+	// they can still hit the player until sweep() removes them.
+	void tick(double delta) {
+		auto d = simd::splat(delta);
+		auto right = simd::splat(world::width), left = simd::splat(-2);
+
+		simd::for_each(0, x_.size(), [&] (size_t i, size_t n) {
+			auto x = simd::load(&x_[i], n) + d * simd::load(&speed_[i], n);
+			simd::store(&x_[i], x, n);
+
+			auto out = simd::bits((x >= right) | (x <= left));
+			for (size_t l = 0; l < n; l++)
+				gone_[i + l] = (out >> l & 1)
+					|| blocks_.check_collision(x_[i + l], y_[i + l], 1, 1);
+		});
+	}
+
+	void register_in(broadphase &bp) const {
+		for (uint32_t i = 0; i < x_.size(); i++)
+			bp.insert(broadphase::kind::bullet, i, x_[i], y_[i], 1, 1);
+	}
+
+	void hit_player(uint32_t id) {
+		gone_[id] = true;
+		events_.push({.kind = event_kind::damage, .from = event_source::bullets, .n = 8});
+		events_.push({.kind = event_kind::sound, .from = event_source::bullets, .s = sound::hit});
+	}
+
+	void sweep() {
+		auto n = simd::compact(x_.size(),
+			[&] (size_t i, size_t n) {
+				uint32_t gone = 0;
+				for (size_t l = 0; l < n; l++)
+					gone |= gone_[i + l] << l;
+				return gone;
+			},
+			[&] (size_t from, size_t to) {
+				x_[to] = x_[from];
+				y_[to] = y_[from];
+				speed_[to] = speed_[from];
+				gone_[to] = gone_[from];
+			});
+
+		resize_(n);
+	}
+
+	void add_bullet(double x, double y, double xspeed) {
+		x_.push_back(x);
+		y_.push_back(y);
+		speed_.push_back(xspeed);
+		gone_.push_back(false);
+	}
+
+	void render(draw_list &list) {
+		for (size_t i = 0; i < x_.size(); i++) {
+			spr_.x = x_[i];
+			spr_.y = y_[i];
+			spr_.render(list, layer::bullets);
+		}
+	}
+
+	void clear() {
+		resize_(0);
+	}
+
+	void save(snapshot_writer &w) const {
+		w.put_vector(x_);
+		w.put_vector(y_);
+		w.put_vector(speed_);
+		w.put_vector(gone_);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get_vector(x_);
+		r.get_vector(y_);
+		r.get_vector(speed_);
+		r.get_vector(gone_);
+		resize_(x_.size());
+	}
+
+	size_t size() const {
+		return x_.size();
+	}
+
+private:
+	void resize_(size_t n) {
+		x_.resize(n);
+		y_.resize(n);
+		speed_.resize(n);
+		gone_.resize(n);
+	}
+
+	// Bullets only ever fly horizontally.
+	std::vector<float> x_, y_, speed_;
+	std::vector<uint8_t> gone_;
+	blocks &blocks_;
+	event_stream &events_;
+	sprite spr_;
+};
+
+// Appends the time as [m:]s.d, e.g. 1:05.3.
+inline void format_time(std::pmr::string &out, double time) {
+	int cs = (int)(time * 10) % 10;
+	int s = (int)(time) % 60;
+	int m = (int)(time / 60);
+
+	auto append = [&] (int v) {
+		char buf[12];
+		auto [end, _] = std::to_chars(buf, buf + sizeof(buf), v);
+		out.append(buf, end);
+	};
+
+	if (m) {
+		append(m);
+		out += ":";
+	}
+
+	if (m && s < 10) {
+		out += "0";
+	}
+
+	append(s);
+	out += ".";
+	append(cs);
+}
+
+inline void render_text_outlined_center(render_queue &queue, int y, text &t, std::string_view text,
+		bool outline = true) {
+	t.set_text(text);
+	if (!outline) {
+		t.x = (screen::width - text.size() * 6) / 2;
+		t.y = y;
+		t.render(queue, layer::text, {1, 1, 1, 1});
+		return;
+	}
+
+	t.x = (screen::width - text.size() * 6) / 2 - 1;
+	t.y = y;
+	t.render(queue, layer::text_outline, {0, 0, 0, 1});
+	t.x = (screen::width - text.size() * 6) / 2 + 1;
+	t.y = y;
+	t.render(queue, layer::text_outline, {0, 0, 0, 1});
+	t.x = (screen::width - text.size() * 6) / 2;
+	t.y = y + 1;
+	t.render(queue, layer::text_outline, {0, 0, 0, 1});
+	t.x = (screen::width - text.size() * 6) / 2;
+	t.y = y - 1;
+	t.render(queue, layer::text_outline, {0, 0, 0, 1});
+	t.x = (screen::width - text.size() * 6) / 2;
+	t.y = y;
+	t.render(queue, layer::text, {1, 1, 1, 1});
+}
+
+struct powerups {
+	powerups(const sprite_sheet &sheet, event_stream &events, rng r)
+	: spr_{sheet}, events_{events}, rng_{r} { }
+
+private:
+	enum class type {
+		medkit, clock
+	};
+
+public:
+	void tick(double delta) {
+		auto dy = simd::splat(delta * 30);
+		auto bottom = simd::splat(world::height);
+
+		simd::for_each(0, y_.size(), [&] (size_t i, size_t n) {
+			auto y = simd::load(&y_[i], n) + dy;
+			simd::store(&y_[i], y, n);
+
+			auto gone = simd::bits(y >= bottom);
+			for (size_t l = 0; l < n; l++)
+				gone_[i + l] = gone >> l & 1;
+		});
+
+		if (time_until_next > 0) {
+			time_until_next -= delta;
+		}
+
+		if (time_until_next <= 0) {
+			time_until_next = 1.5;
+			maybe_add();
+		}
+	}
+
+	void maybe_add() {
+		if (rng_.range(0, 1) && rng_.chance(110)) {
+			add_(rng_.range(0, world::width - 8), type::clock);
+		} else if (rng_.chance(60)) {
+			add_(rng_.range(0, world::width - 8), type::medkit);
+		}
+	}
+
+	void register_in(broadphase &bp) const {
+		for (uint32_t i = 0; i < x_.size(); i++)
+			bp.insert(broadphase::kind::powerup, i, x_[i], y_[i], 7, 7);
+	}
+
+	void pick_up(uint32_t id) {
+		gone_[id] = true;
+
+		if (type_[id] == type::medkit)
+			events_.push({.kind = event_kind::heal, .from = event_source::powerups, .n = 32});
+		else
+			events_.push({.kind = event_kind::power_up, .from = event_source::powerups});
+
+		events_.push({.kind = event_kind::sound, .from = event_source::powerups,
+			.s = sound::pickup});
+	}
+
+	void sweep() {
+		auto n = simd::compact(x_.size(),
+			[&] (size_t i, size_t n) {
+				uint32_t gone = 0;
+				for (size_t l = 0; l < n; l++)
+					gone |= gone_[i + l] << l;
+				return gone;
+			},
+			[&] (size_t from, size_t to) {
+				x_[to] = x_[from];
+				y_[to] = y_[from];
+				type_[to] = type_[from];
+				gone_[to] = gone_[from];
+			});
+
+		resize_(n);
+	}
+
+	void render(draw_list &list) {
+		for (size_t i = 0; i < x_.size(); i++) {
+			spr_.set_frame(type_[i] == type::medkit ? 0 : 1);
+			spr_.x = x_[i];
+			spr_.y = y_[i];
+			spr_.render(list, layer::powerups);
+		}
+	}
+
+	void clear() {
+		resize_(0);
+	}
+
+	size_t size() const {
+		return x_.size();
+	}
+
+	void save(snapshot_writer &w) const {
+		w.put(rng_);
+		w.put(time_until_next);
+		w.put_vector(x_);
+		w.put_vector(y_);
+		w.put_vector(type_);
+		w.put_vector(gone_);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(rng_);
+		r.get(time_until_next);
+		r.get_vector(x_);
+		r.get_vector(y_);
+		r.get_vector(type_);
+		r.get_vector(gone_);
+		resize_(x_.size());
+	}
+
+private:
+	void add_(float x, type t) {
+		x_.push_back(x);
+		y_.push_back(-8);
+		type_.push_back(t);
+		gone_.push_back(false);
+	}
+
+	void resize_(size_t n) {
+		x_.resize(n);
+		y_.resize(n);
+		type_.resize(n);
+		gone_.resize(n);
+	}
+
+	// Pickups only ever fall straight down.
+	std::vector<float> x_, y_;
+	std::vector<type> type_;
+	std::vector<uint8_t> gone_;
+	sprite spr_;
+	event_stream &events_;
+	rng rng_;
+
+	double time_until_next = 1.5;
+};
+
+// Every sheet the game draws from. Loaded as textures to play the game, or
+// with only their layout to simulate it without a GL context.
+struct art {
+	art(gl::program &prog, gl::texture_format format)
+	: art{[&] (const char *path, int w, int h) {
+		return sprite_sheet{prog, path, w, h, format};
+	}} {
+		if (format == gl::texture_format::indexed)
+			add_enemy_palettes_();
+	}
+
+	explicit art(layout_only_t)
+	: art{[] (const char *path, int w, int h) {
+		return sprite_sheet{layout_only, path, w, h};
+	}} { }
+
+private:
+	template <typename F>
+	explicit art(F &&load)
+	: cloud{load("res/cloud.png", 64, 64)},
+		particle{load("res/particle.png", 2, 2)},
+		block{load("res/blocks.png", 8, 8)},
+		player{load("res/player.png", 8, 8)},
+		bullet{load("res/bullet.png", 2, 2)},
+		powerup{load("res/powerups.png", 8, 8)},
+		bg{load("res/bg.png", 160, 120)},
+		healthbar{load("res/healthbar.png", 512, 8)},
+		powerbar{load("res/powerbar.png", 512, 8)} { }
+
+	// The player's colors with the channels rotated, alpha stays.
+	void add_enemy_palettes_() {
+		for (size_t i = 1; i < enemy_palettes.size(); i++) {
+			auto colors = player.texture().base_palette();
+			for (auto &c : colors) {
+				auto rgba = reinterpret_cast<uint8_t *>(&c);
+				std::rotate(rgba, rgba + i, rgba + 3);
+			}
+			enemy_palettes[i] = player.add_palette(colors);
+		}
+	}
+
+public:
+	sprite_sheet cloud, particle, block, player, bullet, powerup, bg, healthbar, powerbar;
+
+	// Enemies are drawn from the player sheet in one of these palette rows,
+	// headless they're all 0.
+	std::array<uint8_t, 3> enemy_palettes{};
+};
+
+struct simulation_options {
+	unsigned workers = job_system::default_workers();
+
+	// Publish a render_state after every tick, nothing reads them headless.
+	bool present = true;
+	bool rewind = record_rewind;
+};
+
+// The game itself, everything but drawing and playing sounds. Owns no GL
+// objects and touches no globals, so any number of them can run side by
+// side on different threads (sharing one art).
+struct simulation {
+	static constexpr double max_power_up_time = 32;
+
+	// Containers have grown to their working size by then.
+	static constexpr double steady_after = 10;
+
+	enum class state {
+		mainmenu, game, gameover, paused
+	};
+
+	// Everything the HUD shows, it's only redrawn when this changes.
+	struct hud_key {
+		state s;
+		int health;
+		bool powered;
+		int power_x;
+		int tenths;
+
+		bool operator==(const hud_key &) const = default;
+	};
+
+	// What the simulation hands over to the render side after every tick.
+	// Only sheets are referenced, everything else is a copy.
+	struct render_state {
+		camera cam;
+
+		draw_list background;
+		uint64_t background_version = 0;
+
+		draw_list world;
+
+		hud_key hud{};
+		double hud_time = 0;
+
+		// Bumped whenever something changed outside of gameplay.
+		uint64_t version = 0;
+		bool animating = false;
+		bool steady = false;
+	};
+
+	simulation(uint64_t seed, const art &sheets, simulation_options opts = {})
+	: seed_{seed}, art_{sheets}, opts_{opts}, jobs_{opts.workers} {
+		build_tick_graph();
+		if (opts_.present)
+			publish_();
+	}
+
+	// tick() and everything it calls may run on a different thread than
+	// the renderer, they only meet in frames_.
+	void tick(double delta, const input_state &input) {
+		time_tracker_.tick(delta);
+		if (clouds_.tick()) {
+			changed_ = true;
+			background_version_++;
+		}
+
+		auto prev_state = state_;
+
+		switch (state_) {
+			case state::game:
+				if (record_rewind && opts_.rewind && input.down(SDL_SCANCODE_BACKSPACE)) {
+					rewind(1);
+				} else {
+					game_tick(delta, input);
+					record_tick_();
+				}
+				break;
+			case state::mainmenu:
+			case state::gameover:
+				gameover_tick(delta, input);
+				break;
+			case state::paused:
+				paused_tick(delta, input);
+				break;
+		}
+
+		if (state_ != prev_state)
+			changed_ = true;
+
+		if (opts_.present)
+			publish_();
+	}
+
+	// Any thread, see quality_levels.
+	void set_quality(int level) {
+		quality_level_.store(level, std::memory_order_relaxed);
+	}
+
+	// Render side, picks up the latest published frame.
+	const render_state &latest_frame() {
+		frames_.acquire();
+		return frames_.front();
+	}
+
+	// Sounds triggered since the last call, one bit per sound.
+	uint32_t take_sounds() {
+		return sounds_.take();
+	}
+
+	state current_state() const {
+		return state_;
+	}
+
+	// Seconds since the current (or last) game started.
+	double survived() const {
+		return (state_ == state::gameover ? end_at_ : time_tracker_.now()) - start_at_;
+	}
+
+	struct entity_counts {
+		size_t enemies, bullets, particles, blocks, powerups;
+	};
+
+	entity_counts counts() const {
+		return {enemies_.size(), bullets_.size(), particles_.size(),
+			blocks_.size(), powerups_.size()};
+	}
+
+	void reset_to_game() {
+		enemies_.clear();
+		blocks_.clear();
+		particles_.clear();
+		bullets_.clear();
+		powerups_.clear();
+
+		player_.reset_vel();
+		player_.set_position(world::width / 2 - 4, world::height / 4);
+		blocks_.add_platform_at((world::width / 8 - 8) / 2, 10, 8);
+		camera_.follow(player_.get_x() + 4, player_.get_y() + 4);
+		broadphase_.clear();
+		health = 160;
+		spawn_cooldown = 0.5;
+		power_up_time_ = 0;
+		stuff_speed_ = 1;
+
+		state_ = state::game;
+		start_at_ = time_tracker_.now();
+		rewind_.clear();
+	}
+
+	// Layout of save(), snapshots of another one are refused.
+	static constexpr uint32_t snapshot_version = 5;
+
+	// Everything the simulation needs to carry on from here, the variable
+	// sized parts go last.
+	void save(snapshot_writer &w) const {
+		w.put(snapshot_version);
+		w.put(state_);
+		w.put(rng_);
+		w.put(health);
+		w.put(start_at_);
+		w.put(end_at_);
+		w.put(power_up_time_);
+		w.put(stuff_speed_);
+		w.put(spawn_cooldown);
+
+		camera_.save(w);
+		time_tracker_.save(w);
+		clouds_.save(w);
+		blocks_.save(w);
+		player_.save(w);
+		bullets_.save(w);
+		powerups_.save(w);
+
+		w.put(static_cast<uint32_t>(enemies_.size()));
+		for (auto &e : enemies_)
+			e->save(w);
+
+		particles_.save(w);
+	}
+
+	bool load(snapshot_reader &r) {
+		if (r.get<uint32_t>() != snapshot_version)
+			return false;
+
+		r.get(state_);
+		r.get(rng_);
+		r.get(health);
+		r.get(start_at_);
+		r.get(end_at_);
+		r.get(power_up_time_);
+		r.get(stuff_speed_);
+		r.get(spawn_cooldown);
+
+		camera_.load(r);
+		time_tracker_.load(r);
+		clouds_.load(r);
+		blocks_.load(r);
+		player_.load(r);
+		bullets_.load(r);
+		powerups_.load(r);
+
+		auto n = r.get<uint32_t>();
+		if (r.failed())
+			return false;
+
+		enemies_.resize(n);
+		for (auto &e : enemies_) {
+			if (!e)
+				e = std::make_unique<enemy>(blocks_, art_.player, events_);
+			e->load(r);
+		}
+
+		particles_.load(r);
+
+		fill_broadphase_();
+		background_version_++;
+		changed_ = true;
+
+		return r.ok();
+	}
+
+	// Goes back to how things were the given number of gameplay ticks ago,
+	// as far as the rewind buffer reaches.
+	bool rewind(size_t ticks) {
+		if (!rewind_.restore(ticks, snapshot_))
+			return false;
+
+		snapshot_reader r{snapshot_};
+		if (!load(r))
+			return false;
+
+		rewind_.drop_latest(ticks);
+		return true;
+	}
+
+	const rewind_buffer &rewind_history() const {
+		return rewind_;
+	}
+
+	// Known states to benchmark and capture the renderer in, always reached
+	// the same way for a given seed.
+	enum class scenario {
+		menu, block_field, particle_storm, game_over
+	};
+
+	void load_scenario(scenario sc) {
+		reset_to_game();
+
+		switch (sc) {
+			case scenario::menu:
+				state_ = state::mainmenu;
+				break;
+			case scenario::block_field:
+				for (int i = 0; i < 200; i++)
+					blocks_.add_platform([] (int, int, int) { return true; });
+				break;
+			case scenario::particle_storm:
+				break;
+			case scenario::game_over:
+				for (int i = 0; i < 50; i++)
+					blocks_.add_platform([] (int, int, int) { return true; });
+				end_at_ = start_at_ + 83.4;
+				state_ = state::gameover;
+				break;
+		}
+
+		changed_ = true;
+	}
+
+	// Called before every tick, keeps up whatever the scenario needs more of.
+	void sustain_scenario(scenario sc) {
+		if (sc != scenario::particle_storm)
+			return;
+
+		for (int i = 0; i < 200; i++)
+			particles_.add_particle(camera_.x() + rng_.range(0, screen::width),
+					camera_.y() + rng_.range(0, screen::height));
+	}
+
+	void game_tick(double delta, const input_state &input) {
+		if (spawn_cooldown <= 0 && rng_.chance(100))
+			blocks_.add_platform(
+			[&] (int x, int y, int len) {
+				bool occupied = false;
+				broadphase_.query(x * 8, y * 8, len * 8, 8,
+					[&] (const broadphase::entry &e) {
+						if (e.k == broadphase::kind::player
+								|| e.k == broadphase::kind::enemy)
+							occupied = true;
+					});
+
+				if (occupied)
+					return false;
+
+				if (!rng_.chance(5)) {
+					if (blocks_.check_collision(x * 8 + len * 4, (y - 1) * 8, 7, 7))
+						return false;
+
+					enemies_.emplace_back(std::make_unique<enemy>(blocks_, art_.player, events_));
+					enemies_.back()->set_position(x * 8 + len * 4, (y - 1) * 8);
+					// Follows from the platform, so it doesn't draw from rng_.
+					enemies_.back()->set_palette(
+							art_.enemy_palettes[len % art_.enemy_palettes.size()]);
+				}
+				return true;
+			});
+		else if (spawn_cooldown > 0)
+			spawn_cooldown -= delta;
+
+		tick_delta_ = delta;
+		tick_input_ = &input;
+		jobs_.run(tick_graph_);
+		apply_events_();
+
+		if (player_.get_y() >= world::height)
+			health -= 2;
+
+		camera_.follow(player_.get_x() + 4, player_.get_y() + 4);
+
+		if (health < 0) {
+			state_ = state::gameover;
+			end_at_ = time_tracker_.now();
+			sounds_.play(sound::gameover);
+		}
+
+		if (input.pressed(SDL_SCANCODE_ESCAPE))
+			state_ = state::paused;
+
+		if (power_up_time_ > 0) {
+			power_up_time_ -= delta;
+		}
+		if (power_up_time_ <= 0) {
+			power_up_time_ = 0;
+			stuff_speed_ = 1;
+		}
+	}
+
+	// Blocks go first since everything else collides against them. After
+	// that particles, enemies, the player and bullets only read the block
+	// field and write their own state, so they run side by side. Anything
+	// they do to each other goes through events_, see apply_events_().
+	void build_tick_graph() {
+		auto &g = tick_graph_;
+
+		auto blocks = g.add([this] {
+			blocks_.tick(tick_delta_ * stuff_speed_);
+		});
+
+		auto particles = g.add_parallel_for(
+			[this] { return particles_.size(); }, 256,
+			[this] (size_t begin, size_t end) {
+				particles_.integrate(begin, end, tick_delta_ * stuff_speed_);
+			});
+
+		auto particles_cull = g.add([this] {
+			particles_.cull();
+		});
+
+		auto enemies = g.add_parallel_for(
+			[this] { return enemies_.size(); }, 4,
+			[this] (size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+					enemies_[i]->tick(tick_delta_ * stuff_speed_, *tick_input_);
+			});
+
+		auto enemies_post = g.add([this] {
+			enemies_post_tick();
+		});
+
+		auto player = g.add([this] {
+			player_.tick(tick_delta_, *tick_input_);
+		});
+
+		auto bullets = g.add([this] {
+			bullets_.tick(tick_delta_ * stuff_speed_);
+		});
+
+		auto powerups = g.add([this] {
+			powerups_.tick(tick_delta_ * stuff_speed_);
+		});
+
+		auto collide = g.add([this] {
+			resolve_collisions();
+		});
+
+		g.depend(particles, blocks);
+		g.depend(particles_cull, particles);
+		g.depend(enemies, blocks);
+		g.depend(player, blocks);
+		g.depend(bullets, blocks);
+
+		// Removes enemies, the broadphase is filled afterwards.
+		g.depend(enemies_post, enemies);
+
+		g.depend(collide, enemies_post);
+		g.depend(collide, bullets);
+		g.depend(collide, powerups);
+		g.depend(collide, player);
+	}
+
+	// Everything that moves is registered into the broadphase after it has
+	// moved, the grid is kept until the next tick so that platform placement
+	// can query it as well.
+	void resolve_collisions() {
+		fill_broadphase_();
+
+		broadphase_.pairs(broadphase::kind::player, broadphase::kind::bullet,
+			[this] (const broadphase::entry &, const broadphase::entry &b) {
+				bullets_.hit_player(b.id);
+			});
+
+		broadphase_.pairs(broadphase::kind::player, broadphase::kind::powerup,
+			[this] (const broadphase::entry &, const broadphase::entry &p) {
+				powerups_.pick_up(p.id);
+			});
+
+		bullets_.sweep();
+		powerups_.sweep();
+	}
+
+	void enemies_post_tick() {
+		for (auto it = enemies_.begin(); it != enemies_.end();) {
+			auto &e = **it;
+			if (e.wants_shoot())
+				events_.push({.kind = event_kind::shoot, .from = event_source::enemies,
+					.n = e.facing() * 30,
+					.x = static_cast<float>(e.get_x() + (e.facing() == 1 ? 8 : -3)),
+					.y = static_cast<float>(e.get_y() + 2)});
+
+			bool exploded = e.explode();
+
+			if (exploded) {
+				events_.push({.kind = event_kind::sound, .from = event_source::enemies,
+					.s = sound::blockfall});
+				events_.push({.kind = event_kind::particles, .from = event_source::enemies,
+					.n = 4,
+					.x = static_cast<float>(e.get_x() + 4),
+					.y = static_cast<float>(e.get_y() + 8)});
+			}
+
+			if (e.get_y() >= world::height || exploded)
+				it = enemies_.erase(it);
+			else
+				++it;
+		}
+	}
+
+	// Side effects of the tick graph, a run of each kind at a time. They're
+	// only visible from the next tick on: bullets shot now first move then.
+	void apply_events_() {
+		events_.take(applying_);
+
+		size_t i = 0;
+		auto run = [&] (event_kind kind, auto &&fn) {
+			for (; i < applying_.size() && applying_[i].kind == kind; i++)
+				fn(applying_[i]);
+		};
+
+		int damage = 0;
+		run(event_kind::damage, [&] (const game_event &ev) { damage += ev.n; });
+		health -= damage;
+
+		run(event_kind::heal, [&] (const game_event &ev) {
+			health = std::min(health + ev.n, 160);
+		});
+
+		run(event_kind::power_up, [&] (const game_event &) {
+			power_up_time_ = max_power_up_time;
+			stuff_speed_ = 0.5;
+		});
+
+		run(event_kind::shoot, [&] (const game_event &ev) {
+			bullets_.add_bullet(ev.x, ev.y, ev.n);
+		});
+
+		// Cosmetic, the quality level decides how many are worth it.
+		auto &q = quality_levels[quality_level_.load(std::memory_order_relaxed)];
+		run(event_kind::particles, [&] (const game_event &ev) {
+			particle_debt_ += ev.n * q.particle_rate;
+			int n = particle_debt_;
+			particle_debt_ -= n;
+
+			for (int i = 0; i < n && particles_.size() < q.particle_cap; i++)
+				particles_.add_particle(ev.x, ev.y);
+		});
+
+		run(event_kind::sound, [&] (const game_event &ev) {
+			sounds_.play(ev.s);
+		});
+	}
+
+	void gameover_tick(double, const input_state &input) {
+		if (input.pressed(SDL_SCANCODE_SPACE))
+			reset_to_game();
+	}
+
+	void paused_tick(double, const input_state &input) {
+		if (input.pressed(SDL_SCANCODE_ESCAPE))
+			state_ = state::game;
+	}
+
+private:
+	uint64_t seed_;
+	const art &art_;
+	simulation_options opts_;
+	job_system jobs_;
+	rng rng_{seed_, rng_stream::scene};
+
+	event_stream events_{jobs_.slots()};
+	std::vector<game_event> applying_;
+
+	std::atomic<int> quality_level_{0};
+	int published_quality_ = 0;
+	float particle_debt_ = 0;
+
+	sound_events sounds_;
+	camera camera_;
+
+	time_tracker time_tracker_;
+
+	clouds<20> clouds_{art_.cloud, time_tracker_, rng{seed_, rng_stream::clouds}};
+
+	particles particles_{art_.particle, rng{seed_, rng_stream::particles}};
+	blocks blocks_{art_.block, events_, rng{seed_, rng_stream::blocks}};
+
+	player player_{blocks_, art_.player, events_};
+	std::vector<std::unique_ptr<enemy>> enemies_;
+
+	bullets bullets_{blocks_, art_.bullet, events_};
+
+	powerups powerups_{art_.powerup, events_, rng{seed_, rng_stream::powerups}};
+
+	broadphase broadphase_;
+
+	int health = 160;
+
+	double start_at_ = 0;
+	double end_at_ = 0;
+
+	double power_up_time_ = 0;
+	double stuff_speed_ = 1;
+
+	double spawn_cooldown = 0;
+
+	state state_ = state::mainmenu;
+
+	void fill_broadphase_() {
+		broadphase_.clear();
+
+		broadphase_.insert(broadphase::kind::player, 0,
+				player_.get_x(), player_.get_y(), 7, 7);
+		for (uint32_t i = 0; i < enemies_.size(); i++)
+			broadphase_.insert(broadphase::kind::enemy, i,
+					enemies_[i]->get_x(), enemies_[i]->get_y(), 7, 7);
+		bullets_.register_in(broadphase_);
+		powerups_.register_in(broadphase_);
+	}
+
+	void record_tick_() {
+		if (!record_rewind || !opts_.rewind)
+			return;
+
+		snapshot_writer w{snapshot_};
+		save(w);
+		rewind_.record(snapshot_);
+	}
+
+	int power_bar_x_() const {
+		return (power_up_time_ - max_power_up_time) * 160.0 / max_power_up_time;
+	}
+
+	hud_key hud_key_() const {
+		bool powered = power_up_time_ > 0;
+		switch (state_) {
+			case state::game:
+				return {state_, health, powered, power_bar_x_(),
+					static_cast<int>((time_tracker_.now() - start_at_) * 10)};
+			case state::paused:
+				return {state_, health, powered, power_bar_x_(), 0};
+			case state::gameover:
+				return {state_, 0, false, 0, static_cast<int>((end_at_ - start_at_) * 10)};
+			default:
+				return {state_, 0, false, 0, 0};
+		}
+	}
+
+	// Fills the next frame for the render side, every subsystem records
+	// its sprites instead of drawing them.
+	void publish_() {
+		auto &f = frames_.back();
+
+		int quality = quality_level_.load(std::memory_order_relaxed);
+		if (quality != published_quality_) {
+			published_quality_ = quality;
+			background_version_++;
+			changed_ = true;
+		}
+
+		f.cam = camera_;
+		f.background.clear();
+		clouds_.render(f.background, quality_levels[quality].clouds);
+		f.background_version = background_version_;
+
+		f.world.clear();
+		switch (state_) {
+			case state::mainmenu:
+				break;
+			case state::paused:
+			case state::game:
+				blocks_.render(f.world);
+				player_.render(f.world);
+				for (auto &e : enemies_)
+					e->render(f.world);
+				bullets_.render(f.world);
+				particles_.render(f.world);
+				powerups_.render(f.world);
+				break;
+			case state::gameover:
+				blocks_.render(f.world);
+				for (auto &e : enemies_)
+					e->render(f.world);
+				break;
+		}
+
+		f.hud = hud_key_();
+		f.hud_time = state_ == state::gameover
+			? end_at_ - start_at_
+			: time_tracker_.now() - start_at_;
+
+		if (changed_)
+			version_++;
+		changed_ = false;
+
+		f.version = version_;
+		f.animating = state_ == state::game;
+		f.steady = f.animating && time_tracker_.now() - start_at_ > steady_after;
+
+		frames_.publish();
+	}
+
+	// Simulation side bookkeeping for publish_().
+	bool changed_ = true;
+	uint64_t version_ = 0;
+	uint64_t background_version_ = 0;
+
+	triple_buffer<render_state> frames_;
+
+	// Keyframes every half a second.
+	rewind_buffer rewind_{rewind_seconds * 60, 30};
+	std::vector<uint8_t> snapshot_;
+
+	job_graph tick_graph_;
+	double tick_delta_ = 0;
+	const input_state *tick_input_ = nullptr;
+};
+
+// Presents a simulation: loads the art, draws the frames it publishes and
+// plays the sounds it triggers, if it has a mixer to play them on.
+struct scene {
+	using scenario = simulation::scenario;
+
+	scene(uint64_t seed, audio_mixer *audio = nullptr)
+	: sim_{seed, art_}, audio_{audio} { }
+
+	// May run on a different thread than render(), see simulation::tick().
+	// It's the only one submitting to the mixer.
+	void tick(double delta, const input_state &input) {
+		sim_.tick(delta, input);
+
+		auto fired = sim_.take_sounds();
+		if (audio_)
+			audio_->submit(fired);
+	}
+
+	// Outside of gameplay only the clouds move, and they do so rarely.
+	frame_status status() {
+		auto &f = sim_.latest_frame();
+		return {f.version != drawn_version_ || f.animating, f.animating, f.steady};
+	}
+
+	void load_scenario(scenario sc) {
+		sim_.load_scenario(sc);
+	}
+
+	void sustain_scenario(scenario sc) {
+		sim_.sustain_scenario(sc);
+	}
+
+	simulation &sim() {
+		return sim_;
+	}
+
+	const render_queue::stats &render_stats() const {
+		return queue_.last_stats();
+	}
+
+	// From the window every frame, before render().
+	void set_quality(const quality_report &report) {
+		if (quality_levels[report.level].outlined_text != knobs_().outlined_text)
+			hud_layer_.mark_dirty();
+
+		quality_ = report;
+		sim_.set_quality(report.level);
+	}
+
+	void render() {
+		auto &f = sim_.latest_frame();
+
+		queue_.set_views(f.cam, ortho);
+
+		// The clouds are cached for the whole world, so that following the
+		// player doesn't make them dirty. The background is a single quad
+		// either way.
+		if (f.background_version != drawn_background_) {
+			drawn_background_ = f.background_version;
+			clouds_layer_.mark_dirty();
+		}
+
+		if (clouds_layer_.dirty()) {
+			auto &q = clouds_layer_.begin(queue_);
+			f.background.replay(q);
+			clouds_layer_.end();
+		}
+		clouds_layer_.composite(queue_);
+
+		bg_.render(queue_, layer::background);
+
+		f.world.replay(queue_);
+
+		if (f.hud != last_hud_) {
+			last_hud_ = f.hud;
+			hud_layer_.mark_dirty();
+		}
+
+		if (hud_layer_.dirty()) {
+			auto &q = hud_layer_.begin(queue_);
+			hud_render(q, f.hud, f.hud_time);
+			hud_layer_.end();
+		}
+		hud_layer_.composite(queue_);
+
+		if (quality_.visible)
+			stats_render_();
+
+		queue_.flush();
+		drawn_version_ = f.version;
+	}
+
+	void hud_render(render_queue &queue, const simulation::hud_key &hud, double time) {
+		bool outline = knobs_().outlined_text;
+
+		switch (hud.s) {
+			case simulation::state::mainmenu:
+				render_text_outlined_center(queue, 22, time_text_, "Ancient Pixels", outline);
+
+				render_text_outlined_center(queue, 80, time_text_, "Press Space", outline);
+				render_text_outlined_center(queue, 92, time_text_, "to play", outline);
+				break;
+
+			case simulation::state::paused:
+			case simulation::state::game:
+				if (hud.s == simulation::state::paused) {
+					render_text_outlined_center(queue, 6, time_text_, "Paused", outline);
+				} else {
+					std::pmr::string text{"Time: ", &frame_memory()};
+					format_time(text, time);
+					render_text_outlined_center(queue, 6, time_text_, text, outline);
+				}
+
+				hp_.x = hud.health - 160;
+				hp_.render(queue, layer::hud);
+
+				if (hud.powered) {
+					pp_.x = hud.power_x;
+					pp_.y = screen::height - 8;
+					pp_.render(queue, layer::hud);
+				}
+				break;
+
+			case simulation::state::gameover: {
+				std::pmr::string text{"Final Time: ", &frame_memory()};
+				format_time(text, time);
+
+				render_text_outlined_center(queue, 6, time_text_, "Game over", outline);
+				render_text_outlined_center(queue, 18, time_text_, text, outline);
+
+				render_text_outlined_center(queue, 80, time_text_, "Press Space", outline);
+				render_text_outlined_center(queue, 92, time_text_, "to play again", outline);
+				break;
+			}
+		}
+	}
+
+private:
+	gl::program prog_{
+		gl::shader{GL_VERTEX_SHADER, "res/shaders/generic-vertex.glsl"},
+		gl::shader{GL_FRAGMENT_SHADER, "res/shaders/generic-fragment.glsl"}
+	};
+
+	// All of the art is stored as palette indices, see gl::texture_format.
+	static constexpr auto art_format = gl::texture_format::indexed;
+
+	gl::program indexed_prog_{
+		gl::shader{GL_VERTEX_SHADER, "res/shaders/generic-vertex.glsl"},
+		gl::shader{GL_FRAGMENT_SHADER, "res/shaders/indexed-fragment.glsl"}
+	};
+	gl::program &art_prog_ = art_format == gl::texture_format::indexed ? indexed_prog_ : prog_;
+
+	font fnt_{"res/font.txt", art_format};
+
+	render_queue queue_;
+
+	art art_{art_prog_, art_format};
+	simulation sim_;
+	audio_mixer *audio_;
+
+	text time_text_{art_prog_, fnt_};
+
+	sprite bg_{art_.bg};
+	sprite hp_{art_.healthbar};
+	sprite pp_{art_.powerbar};
+
+	// What the last drawn frame was made from.
+	uint64_t drawn_version_ = -1;
+	uint64_t drawn_background_ = -1;
+
+	retained_layer clouds_layer_{prog_, layer::clouds, world::width, world::height};
+	retained_layer hud_layer_{prog_, layer::hud, screen::width, screen::height};
+	simulation::hud_key last_hud_{};
+
+	const quality_knobs &knobs_() const {
+		return quality_levels[quality_.level];
+	}
+
+	// Changes every frame, so it's drawn straight into the queue.
+	void stats_render_() {
+		std::pmr::string text{"Q", &frame_memory()};
+		auto append = [&] (auto v, auto... args) {
+			char buf[16];
+			auto [end, _] = std::to_chars(buf, buf + sizeof(buf), v, args...);
+			text.append(buf, end);
+		};
+
+		append(quality_.level);
+		text += " ";
+		append(quality_.frame_ms, std::chars_format::fixed, 1);
+		text += "/";
+		append(quality_.tick_ms, std::chars_format::fixed, 1);
+		text += "ms";
+
+		// Above the power bar, and over the rest of the HUD.
+		stats_text_.set_text(text);
+		stats_text_.x = 2;
+		stats_text_.y = screen::height - 18;
+		stats_text_.render(queue_, layer::overlay, {1, 1, 1, 1});
+	}
+
+	text stats_text_{art_prog_, fnt_};
+	quality_report quality_;
+
+	glm::mat4 ortho = glm::ortho(0.f, static_cast<float>(screen::width),
+			static_cast<float>(screen::height), 0.f);
+};
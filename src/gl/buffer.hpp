@@ -81,7 +81,7 @@ struct buffer {
 			size_ = size;
 			glBufferData(Type, size_, data, usage_);
 		} else {
-			glBufferSubData(Type, 0, size_, data);
+			glBufferSubData(Type, 0, size, data);
 		}
 	}
 
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <GLES2/gl2.h>
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <utility>
+#include <gl/texture.hpp>
+#include <gl/vertex.hpp>
+
+namespace gl {
+
+struct framebuffer {
+	friend void swap(framebuffer &a, framebuffer &b) {
+		using std::swap;
+		swap(a.id_, b.id_);
+		swap(a.color_, b.color_);
+	}
+
+	framebuffer()
+	: id_{}, color_{} { }
+
+	~framebuffer() {
+		glDeleteFramebuffers(1, &id_);
+	}
+
+	framebuffer(const framebuffer &) = delete;
+	framebuffer &operator=(const framebuffer &) = delete;
+
+	framebuffer(framebuffer &&other)
+	: framebuffer() {
+		swap(*this, other);
+	}
+
+	framebuffer &operator=(framebuffer &&other) {
+		swap(*this, other);
+		return *this;
+	}
+
+	void create(int w, int h) {
+		color_.create(w, h);
+
+		glGenFramebuffers(1, &id_);
+		glBindFramebuffer(GL_FRAMEBUFFER, id_);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_.id(), 0);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << __func__ << ": framebuffer " << w << "x" << h << " is incomplete" << std::endl;
+			assert(!"incomplete framebuffer");
+		}
+
+		unbind();
+	}
+
+	// Also sets the viewport to cover the whole color target.
+	void bind() const {
+		assert(id_);
+		glBindFramebuffer(GL_FRAMEBUFFER, id_);
+		glViewport(0, 0, color_.width(), color_.height());
+	}
+
+	static void unbind() {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	const texture2d &color() const {
+		return color_;
+	}
+
+	// Two triangles covering a target-sized rectangle at the origin, mapped
+	// so that the color texture shows up the right way round. Framebuffer
+	// contents are stored bottom-up.
+	std::array<vertex, 6> quad() const {
+		float w = color_.width(), h = color_.height();
+		return {
+			vertex{{0, 0}, {0, 1}},
+			vertex{{w, 0}, {1, 1}},
+			vertex{{w, h}, {1, 0}},
+
+			vertex{{0, 0}, {0, 1}},
+			vertex{{w, h}, {1, 0}},
+			vertex{{0, h}, {0, 0}}
+		};
+	}
+
+	GLuint id() const {
+		return id_;
+	}
+
+private:
+	GLuint id_;
+	texture2d color_;
+};
+
+} // namespace gl
@@ -157,6 +157,11 @@ struct program {
 		glUniform4fv(loc, 1, glm::value_ptr(val));
 	}
 
+	void set_uniform(const std::string &name, float val) {
+		auto loc = glGetUniformLocation(id_, name.c_str());
+		glUniform1f(loc, val);
+	}
+
 	void set_uniform(const std::string &name, int val) {
 		auto loc = glGetUniformLocation(id_, name.c_str());
 		glUniform1i(loc, val);
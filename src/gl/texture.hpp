@@ -2,24 +2,49 @@
 
 #include <SDL2/SDL_image.h>
 #include <GLES2/gl2.h>
+#include <array>
 #include <cassert>
 #include <iostream>
+#include <vector>
+#include <stdint.h>
 
 namespace gl {
 
+enum class texture_format {
+	rgba,
+	// One byte palette index per texel plus a palette texture, pixel art
+	// rarely uses more than a handful of colors.
+	indexed
+};
+
+// RGBA colors as they are laid out in memory.
+using palette = std::array<uint32_t, 256>;
+
 struct texture2d {
 	friend void swap(texture2d &a, texture2d &b) {
 		using std::swap;
 		swap(a.id_, b.id_);
 		swap(a.surf_, b.surf_);
+		swap(a.width_, b.width_);
+		swap(a.height_, b.height_);
+		swap(a.format_, b.format_);
+		swap(a.palette_id_, b.palette_id_);
+		swap(a.palettes_, b.palettes_);
 	}
 
+	// Rows of the palette texture, has to match indexed-fragment.glsl.
+	static constexpr int max_palettes = 16;
+
 	texture2d()
-	: id_{}, surf_{} { }
+	: id_{}, surf_{}, width_{}, height_{} { }
 
+	// Never loaded ones may not even have a context to go with them.
 	~texture2d() {
 		SDL_FreeSurface(surf_);
-		glDeleteTextures(1, &id_);
+		if (id_)
+			glDeleteTextures(1, &id_);
+		if (palette_id_)
+			glDeleteTextures(1, &palette_id_);
 	}
 
 	texture2d(const texture2d &) = delete;
@@ -45,12 +70,26 @@ struct texture2d {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	}
 
+	// Indexed textures also bind their palette to texture unit 1.
 	void bind() const {
+		if (palette_id_) {
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, palette_id_);
+			glActiveTexture(GL_TEXTURE0);
+		}
+
 		glBindTexture(GL_TEXTURE_2D, id_);
 	}
 
-	void load(const std::string &path) {
+	void load(const std::string &path, texture_format format = texture_format::rgba) {
 		surf_ = IMG_Load(path.data());
+		format_ = format;
+
+		if (surf_ && format_ == texture_format::indexed) {
+			auto conv = SDL_ConvertSurfaceFormat(surf_, SDL_PIXELFORMAT_RGBA32, 0);
+			SDL_FreeSurface(surf_);
+			surf_ = conv;
+		}
 
 		if (surf_) {
 			restore();
@@ -61,29 +100,134 @@ struct texture2d {
 	}
 
 	void restore() {
-		if (surf_) {
+		if (surf_ && format_ == texture_format::indexed) {
+			restore_indexed_();
+		} else if (surf_) {
 			auto mode = GL_RGB;
 			if (surf_->format->BytesPerPixel == 4)
 				mode = GL_RGBA;
 
 			generate();
 
+			width_ = surf_->w;
+			height_ = surf_->h;
 			glTexImage2D(GL_TEXTURE_2D, 0, mode, surf_->w, surf_->h, 0, mode, GL_UNSIGNED_BYTE, surf_->pixels);
 		}
 	}
 
+	// Empty RGBA texture, e.g. to render into.
+	void create(int w, int h) {
+		generate();
+
+		width_ = w;
+		height_ = h;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	GLuint id() const {
+		return id_;
+	}
+
 	int width() const {
-		return surf_->w;
+		return width_;
 	}
 
 	int height() const {
-		return surf_->h;
+		return height_;
+	}
+
+	bool indexed() const {
+		return palette_id_;
+	}
+
+	// The colors the image was loaded with.
+	const palette &base_palette() const {
+		assert(!palettes_.empty());
+		return palettes_.front();
+	}
+
+	// Adds an alternative palette for the same indices and returns the row
+	// to draw with. Costs one tiny upload, drawing with it is free.
+	int add_palette(const palette &colors) {
+		assert(indexed() && palettes_.size() < max_palettes);
+		palettes_.push_back(colors);
+		upload_palettes_();
+		return palettes_.size() - 1;
 	}
 
 private:
+	// Palettes added after loading are kept.
+	void restore_indexed_() {
+		if (palettes_.empty())
+			palettes_.resize(1);
+		auto &colors = palettes_.front();
+		colors.fill(0);
+
+		size_t n_colors = 0;
+		std::vector<uint8_t> indices(surf_->w * surf_->h);
+
+		for (int y = 0; y < surf_->h; y++) {
+			auto row = reinterpret_cast<const uint32_t *>(
+					static_cast<const uint8_t *>(surf_->pixels) + y * surf_->pitch);
+
+			for (int x = 0; x < surf_->w; x++) {
+				size_t i = 0;
+				while (i < n_colors && colors[i] != row[x])
+					i++;
+
+				if (i == n_colors) {
+					if (n_colors == colors.size()) {
+						std::cerr << __func__ << ": image has more than "
+							<< colors.size() << " colors" << std::endl;
+						assert(!"too many colors for an indexed texture");
+						return;
+					}
+
+					colors[n_colors++] = row[x];
+				}
+
+				indices[y * surf_->w + x] = i;
+			}
+		}
+
+		generate();
+
+		width_ = surf_->w;
+		height_ = surf_->h;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, width_, height_, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, indices.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		upload_palettes_();
+	}
+
+	void upload_palettes_() {
+		if (!palette_id_) {
+			glGenTextures(1, &palette_id_);
+			glBindTexture(GL_TEXTURE_2D, palette_id_);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, max_palettes, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		} else {
+			glBindTexture(GL_TEXTURE_2D, palette_id_);
+		}
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, palettes_.size(), GL_RGBA, GL_UNSIGNED_BYTE, palettes_.data());
+	}
+
 	GLuint id_;
 
 	SDL_Surface *surf_ = nullptr;
+	int width_;
+	int height_;
+
+	texture_format format_ = texture_format::rgba;
+	GLuint palette_id_ = 0;
+	std::vector<palette> palettes_;
 };
 
 } // namespace gl
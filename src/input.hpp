@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+struct input_event {
+	uint64_t time; // in input_state::time_frequency units, as of arrival
+	SDL_Scancode key;
+	bool down;
+};
+
+// Raw key events in the order they arrived, the oldest ones get overwritten
+// once it fills up.
+struct input_ring {
+	static constexpr size_t capacity = 64;
+
+	void push(const input_event &ev) {
+		events_[(head_ + size_) % capacity] = ev;
+		if (size_ < capacity)
+			size_++;
+		else
+			head_ = (head_ + 1) % capacity;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	// 0 is the oldest event still in the ring.
+	const input_event &operator[](size_t i) const {
+		return events_[(head_ + i) % capacity];
+	}
+
+	void clear() {
+		head_ = size_ = 0;
+	}
+
+private:
+	std::array<input_event, capacity> events_{};
+	size_t head_ = 0;
+	size_t size_ = 0;
+};
+
+// Trivially copyable, so snapshotting it for recording is a plain copy.
+struct input_state {
+	using key_set = std::bitset<SDL_NUM_SCANCODES>;
+
+	int mouse_x, mouse_y;
+
+	key_set down_keys;
+	key_set pressed_keys;
+	key_set released_keys;
+
+	// Events received during the current frame are the last frame_events
+	// entries of the ring.
+	input_ring events;
+	size_t frame_events = 0;
+
+	// Event times count this many per second, SDL_GetPerformanceFrequency()
+	// for real input.
+	uint64_t time_frequency = 1000;
+
+	bool down(SDL_Scancode key) const {
+		return down_keys[key];
+	}
+
+	bool pressed(SDL_Scancode key) const {
+		return pressed_keys[key];
+	}
+
+	bool released(SDL_Scancode key) const {
+		return released_keys[key];
+	}
+
+	void begin_frame() {
+		pressed_keys.reset();
+		released_keys.reset();
+		frame_events = 0;
+	}
+
+	void key_down(SDL_Scancode key, uint64_t time) {
+		if (key < 0 || key >= SDL_NUM_SCANCODES || down_keys[key])
+			return;
+
+		pressed_keys[key] = true;
+		down_keys[key] = true;
+		record_({time, key, true});
+	}
+
+	void key_up(SDL_Scancode key, uint64_t time) {
+		if (key < 0 || key >= SDL_NUM_SCANCODES || !down_keys[key])
+			return;
+
+		released_keys[key] = true;
+		down_keys[key] = false;
+		record_({time, key, false});
+	}
+
+private:
+	void record_(const input_event &ev) {
+		events.push(ev);
+		if (frame_events < input_ring::capacity)
+			frame_events++;
+	}
+};
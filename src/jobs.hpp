@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+inline constexpr bool jobs_have_threads = false;
+#else
+inline constexpr bool jobs_have_threads = true;
+#endif
+
+struct job_system;
+
+// A set of jobs and the edges between them. The graph is meant to be built
+// once and then run every tick, parallel-for jobs query their item count
+// right before they get scheduled.
+struct job_graph {
+	friend struct job_system;
+
+	using job_id = size_t;
+
+	job_id add(std::function<void()> fn) {
+		auto &n = nodes_.emplace_back();
+		n.count = [] { return size_t{1}; };
+		n.chunk = 1;
+		n.fn = [fn = std::move(fn)] (size_t, size_t) { fn(); };
+		return nodes_.size() - 1;
+	}
+
+	job_id add_parallel_for(std::function<size_t()> count, size_t chunk,
+			std::function<void(size_t, size_t)> fn) {
+		auto &n = nodes_.emplace_back();
+		n.count = std::move(count);
+		n.chunk = chunk ? chunk : 1;
+		n.fn = std::move(fn);
+		return nodes_.size() - 1;
+	}
+
+	// Makes `after` wait until `before` has completed.
+	void depend(job_id after, job_id before) {
+		nodes_[before].successors.push_back(after);
+		nodes_[after].n_deps++;
+	}
+
+	void clear() {
+		nodes_.clear();
+	}
+
+private:
+	struct node {
+		std::function<size_t()> count;
+		size_t chunk;
+		std::function<void(size_t, size_t)> fn;
+
+		std::vector<job_id> successors;
+		size_t n_deps = 0;
+
+		std::atomic<size_t> deps_left{0};
+		std::atomic<size_t> chunks_left{0};
+	};
+
+	std::deque<node> nodes_;
+};
+
+struct job_system {
+	static unsigned default_workers() {
+		if constexpr (!jobs_have_threads)
+			return 0;
+
+		unsigned n = std::thread::hardware_concurrency();
+		return n > 1 ? n - 1 : 0;
+	}
+
+	job_system(unsigned n_workers = default_workers())
+	: queues_(n_workers + 1) {
+		if constexpr (jobs_have_threads) {
+			for (unsigned i = 0; i < n_workers; i++)
+				workers_.emplace_back([this, i] { worker_loop_(i); });
+		}
+	}
+
+	~job_system() {
+		{
+			std::lock_guard lock{sleep_mutex_};
+			stop_ = true;
+		}
+		sleep_cv_.notify_all();
+
+		for (auto &t : workers_)
+			t.join();
+	}
+
+	job_system(const job_system &) = delete;
+	job_system &operator=(const job_system &) = delete;
+
+	size_t n_workers() const {
+		return workers_.size();
+	}
+
+	// Every thread running jobs has a slot of its own in [0, slots()), for
+	// per-thread data that jobs write to without locking. Outside of run()
+	// the calling thread counts as slot 0, no job runs concurrently then.
+	size_t slots() const {
+		return queues_.size();
+	}
+
+	static size_t current_slot() {
+		return slot_;
+	}
+
+	// Runs the whole graph, the calling thread helps out until it's done.
+	void run(job_graph &g) {
+		auto prev_slot = std::exchange(slot_, main_queue_());
+		graph_ = &g;
+		pending_.store(g.nodes_.size(), std::memory_order_relaxed);
+
+		for (auto &n : g.nodes_)
+			n.deps_left.store(n.n_deps, std::memory_order_relaxed);
+
+		auto self = main_queue_();
+		for (size_t i = 0; i < g.nodes_.size(); i++)
+			if (!g.nodes_[i].n_deps)
+				schedule_(self, i);
+
+		while (pending_.load(std::memory_order_acquire)) {
+			task t;
+			if (try_get_(self, t))
+				execute_(self, t);
+			else
+				std::this_thread::yield();
+		}
+
+		graph_ = nullptr;
+		slot_ = prev_slot;
+	}
+
+private:
+	struct task {
+		job_graph::job_id node;
+		size_t begin, end;
+	};
+
+	struct queue {
+		std::mutex mutex;
+		std::deque<task> tasks;
+	};
+
+	size_t main_queue_() const {
+		return queues_.size() - 1;
+	}
+
+	void push_(size_t q, task t) {
+		{
+			std::lock_guard lock{queues_[q].mutex};
+			queues_[q].tasks.push_back(t);
+		}
+		queued_.fetch_add(1, std::memory_order_release);
+	}
+
+	void wake_() {
+		if (workers_.empty())
+			return;
+
+		{
+			std::lock_guard lock{sleep_mutex_};
+		}
+		sleep_cv_.notify_all();
+	}
+
+	// Owners take the newest task from their own queue, thieves take the
+	// oldest one from somebody else's.
+	bool try_get_(size_t q, task &t) {
+		{
+			auto &own = queues_[q];
+			std::lock_guard lock{own.mutex};
+			if (!own.tasks.empty()) {
+				t = own.tasks.back();
+				own.tasks.pop_back();
+				queued_.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		for (size_t i = 1; i < queues_.size(); i++) {
+			auto &victim = queues_[(q + i) % queues_.size()];
+			std::lock_guard lock{victim.mutex};
+			if (!victim.tasks.empty()) {
+				t = victim.tasks.front();
+				victim.tasks.pop_front();
+				queued_.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void schedule_(size_t q, job_graph::job_id id) {
+		auto &n = graph_->nodes_[id];
+		size_t count = n.count();
+
+		if (!count) {
+			complete_(q, id);
+			return;
+		}
+
+		size_t n_chunks = (count + n.chunk - 1) / n.chunk;
+		n.chunks_left.store(n_chunks, std::memory_order_relaxed);
+
+		for (size_t begin = 0; begin < count; begin += n.chunk)
+			push_(q, {id, begin, std::min(begin + n.chunk, count)});
+
+		wake_();
+	}
+
+	void execute_(size_t q, const task &t) {
+		auto &n = graph_->nodes_[t.node];
+		n.fn(t.begin, t.end);
+
+		if (n.chunks_left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			complete_(q, t.node);
+	}
+
+	void complete_(size_t q, job_graph::job_id id) {
+		for (auto succ : graph_->nodes_[id].successors) {
+			auto &s = graph_->nodes_[succ];
+			if (s.deps_left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				schedule_(q, succ);
+		}
+
+		pending_.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	void worker_loop_(size_t q) {
+		slot_ = q;
+
+		while (true) {
+			task t;
+			if (try_get_(q, t)) {
+				execute_(q, t);
+				continue;
+			}
+
+			std::unique_lock lock{sleep_mutex_};
+			sleep_cv_.wait(lock, [this] {
+				return stop_ || queued_.load(std::memory_order_acquire);
+			});
+
+			if (stop_)
+				return;
+		}
+	}
+
+	std::vector<queue> queues_;
+	std::vector<std::thread> workers_;
+
+	job_graph *graph_ = nullptr;
+	std::atomic<size_t> pending_{0};
+	std::atomic<size_t> queued_{0};
+
+	std::mutex sleep_mutex_;
+	std::condition_variable sleep_cv_;
+	bool stop_ = false;
+
+	static inline thread_local size_t slot_ = 0;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+// Trade detail for frame time when frames take longer than
+// frame_budget_ms, and bring it back once they're well under it again.
+inline constexpr bool adapt_quality = true;
+inline constexpr double frame_budget_ms = 12;
+
+// Print every change of the quality level, the F3 readout shows the same.
+inline constexpr bool log_quality_changes = false;
+
+// Everything that can be given up without changing how the game plays.
+struct quality_knobs {
+	// Fraction of the particles asked for that get emitted, and how many
+	// may be alive at once.
+	float particle_rate;
+	size_t particle_cap;
+
+	// How many of the clouds are drawn.
+	size_t clouds;
+
+	bool outlined_text;
+
+	// Always render at the native resolution and upscale, even if direct
+	// rendering was asked for.
+	bool force_offscreen;
+};
+
+// Level 0 is full quality, every level after it gives up a bit more.
+inline constexpr std::array<quality_knobs, 4> quality_levels{{
+	{1.f, SIZE_MAX, 20, true, false},
+	{.5f, 2048, 12, true, true},
+	{.25f, 1024, 6, false, true},
+	{.1f, 256, 3, false, true},
+}};
+
+// What the governor decided and why, for the stats readout.
+struct quality_report {
+	int level = 0;
+	double frame_ms = 0; // mean of the last window
+	double tick_ms = 0;
+	bool visible = false; // drawn in a corner of the screen
+};
+
+// Steps the quality level down as soon as a window of frames averages over
+// the budget, and back up only after several windows in a row well under
+// it, so that it doesn't flip back and forth around the budget.
+struct quality_governor {
+	static constexpr int window = 30;
+	static constexpr double restore_below = 0.6;
+	static constexpr int restore_after = 4;
+
+	// Frame time being whatever the frame cost us, waiting for vsync aside.
+	// Returns whether the level changed.
+	bool add_frame(double frame_ms, double tick_ms) {
+		frame_sum_ += frame_ms;
+		tick_sum_ += tick_ms;
+		if (++frames_ < window)
+			return false;
+
+		report_.frame_ms = frame_sum_ / frames_;
+		report_.tick_ms = tick_sum_ / frames_;
+		frame_sum_ = tick_sum_ = 0;
+		frames_ = 0;
+
+		if constexpr (!adapt_quality)
+			return false;
+
+		constexpr int worst = quality_levels.size() - 1;
+		double cost = std::max(report_.frame_ms, report_.tick_ms);
+
+		if (cost > frame_budget_ms) {
+			calm_ = 0;
+			if (report_.level == worst)
+				return false;
+
+			report_.level++;
+			return true;
+		}
+
+		if (cost > frame_budget_ms * restore_below || report_.level == 0) {
+			calm_ = 0;
+			return false;
+		}
+
+		if (++calm_ < restore_after)
+			return false;
+
+		calm_ = 0;
+		report_.level--;
+		return true;
+	}
+
+	int level() const {
+		return report_.level;
+	}
+
+	const quality_knobs &knobs() const {
+		return quality_levels[report_.level];
+	}
+
+	const quality_report &report() const {
+		return report_;
+	}
+
+private:
+	quality_report report_;
+	double frame_sum_ = 0;
+	double tick_sum_ = 0;
+	int frames_ = 0;
+	int calm_ = 0;
+};
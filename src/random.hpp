@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+// Identifies independent streams derived from the same seed, every
+// subsystem draws from its own one.
+enum class rng_stream : uint64_t {
+	scene,
+	clouds,
+	particles,
+	blocks,
+	powerups,
+	// Made up input, see bench/soak.cpp.
+	input
+};
+
+// PCG32 (XSH RR), 16 bytes of state.
+struct rng {
+	rng() = default;
+
+	rng(uint64_t seed, rng_stream stream) {
+		inc_ = (static_cast<uint64_t>(stream) << 1) | 1;
+		next();
+		state_ += seed;
+		next();
+	}
+
+	uint32_t next() {
+		uint64_t old = state_;
+		state_ = old * 6364136223846793005ULL + inc_;
+
+		auto xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+		auto rot = static_cast<uint32_t>(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	}
+
+	// Uniform integer in [lo, hi], Lemire's multiply-shift with rejection
+	// so it stays unbiased.
+	int range(int lo, int hi) {
+		auto n = static_cast<uint32_t>(hi - lo) + 1;
+		if (!n)
+			return lo + static_cast<int>(next());
+
+		uint64_t m = static_cast<uint64_t>(next()) * n;
+		auto l = static_cast<uint32_t>(m);
+		if (l < n) {
+			uint32_t t = -n % n;
+			while (l < t) {
+				m = static_cast<uint64_t>(next()) * n;
+				l = static_cast<uint32_t>(m);
+			}
+		}
+
+		return lo + static_cast<int>(m >> 32);
+	}
+
+	// Uniform real in [lo, hi).
+	double uniform(double lo, double hi) {
+		return lo + (hi - lo) * (next() * 0x1p-32);
+	}
+
+	bool chance(uint32_t one_in) {
+		return !range(0, one_in - 1);
+	}
+
+private:
+	uint64_t state_ = 0x853c49e6748fea9bULL;
+	uint64_t inc_ = 0xda3e39cb94b95bdbULL;
+};
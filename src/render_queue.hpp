@@ -0,0 +1,331 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include <gl/vertex.hpp>
+#include <gl/buffer.hpp>
+#include <gl/shader.hpp>
+#include <gl/texture.hpp>
+
+#include <camera.hpp>
+
+// Layers are drawn in declaration order, everything else in the key only
+// exists to group draws that share state.
+enum class layer : uint8_t {
+	clouds,
+	background,
+	blocks,
+	entities,
+	bullets,
+	particles,
+	powerups,
+	text_outline,
+	text,
+	hud,
+	overlay // over the composited HUD
+};
+
+// The background and everything from the text up are pinned to the screen,
+// the rest lives in the world and moves with the camera.
+constexpr bool is_screen_space(layer l) {
+	return l == layer::background || l >= layer::text_outline;
+}
+
+enum class blend_mode : uint8_t {
+	opaque,
+	alpha,
+	premultiplied // for compositing textures produced by flush_into_layer()
+};
+
+struct render_queue {
+	// Key layout, most significant first:
+	// layer (8) | blend (4) | program (12) | texture (16) | depth (24)
+	// GL ids are truncated to fit, so the key only groups draws, batching
+	// still compares the real program and texture. Depth orders draws that
+	// share state, nothing needs that yet so everybody submits 0 and those
+	// keep the order they were submitted in.
+	static constexpr int depth_bits = 24;
+	static constexpr int texture_bits = 16;
+	static constexpr int program_bits = 12;
+	static constexpr int blend_bits = 4;
+
+	static constexpr uint64_t make_key(layer l, blend_mode b, GLuint prog,
+			GLuint tex, uint32_t depth) {
+		uint64_t key = static_cast<uint64_t>(l);
+		key = (key << blend_bits) | (static_cast<uint64_t>(b) & ((1 << blend_bits) - 1));
+		key = (key << program_bits) | (prog & ((1 << program_bits) - 1));
+		key = (key << texture_bits) | (tex & ((1 << texture_bits) - 1));
+		key = (key << depth_bits) | (depth & ((1 << depth_bits) - 1));
+		return key;
+	}
+
+	// Strips the depth, what's left is the GL state a command needs.
+	static constexpr uint64_t state_of(uint64_t key) {
+		return key >> depth_bits;
+	}
+
+	static constexpr layer layer_of(uint64_t key) {
+		return static_cast<layer>(key >> (depth_bits + texture_bits + program_bits + blend_bits));
+	}
+
+	static constexpr blend_mode blend_of(uint64_t key) {
+		return static_cast<blend_mode>((key >> (depth_bits + texture_bits + program_bits))
+				& ((1 << blend_bits) - 1));
+	}
+
+	struct stats {
+		size_t commands;
+		size_t draws;
+		size_t program_changes;
+		size_t texture_changes;
+		size_t blend_changes;
+		size_t culled;
+	};
+
+	render_queue() {
+		vbo_.generate();
+	}
+
+	render_queue(const render_queue &) = delete;
+	render_queue &operator=(const render_queue &) = delete;
+
+	void set_views(const camera &cam, glm::mat4 screen) {
+		cam_ = &cam;
+		world_view_ = cam.transform();
+		screen_view_ = screen;
+	}
+
+	// For targets that aren't looked at through a camera, nothing is culled.
+	void set_views(glm::mat4 world, glm::mat4 screen) {
+		cam_ = nullptr;
+		world_view_ = world;
+		screen_view_ = screen;
+	}
+
+	// Culling pass for world-space submissions, callers skip anything that
+	// isn't inside the camera rectangle.
+	bool visible(layer l, double x, double y, double w, double h) {
+		if (is_screen_space(l) || !cam_ || cam_->visible(x, y, w, h))
+			return true;
+
+		culled_++;
+		return false;
+	}
+
+	// Vertices are copied with the offset applied, so the caller is free to
+	// reuse or modify its geometry right after submitting. The palette only
+	// matters for indexed textures.
+	void submit(layer l, blend_mode b, gl::program &prog, const gl::texture2d &tex,
+			const gl::vertex *verts, size_t n_verts, glm::vec2 offset,
+			glm::vec4 color, uint32_t depth = 0, uint8_t palette = 0) {
+		auto first = static_cast<uint32_t>(verts_.size());
+		for (size_t i = 0; i < n_verts; i++)
+			verts_.push_back({verts[i].pos + offset, verts[i].tex});
+
+		cmds_.push_back({
+			make_key(l, b, prog.id(), tex.id(), depth),
+			first, static_cast<uint32_t>(n_verts),
+			color, palette, &prog, &tex
+		});
+	}
+
+	void flush() {
+		flush_(false);
+	}
+
+	// Same as flush(), for a target that starts out transparent. Alpha is
+	// accumulated separately so the result can be composited as
+	// premultiplied without fringes around translucent texels.
+	void flush_into_layer() {
+		flush_(true);
+	}
+
+	const stats &last_stats() const {
+		return stats_;
+	}
+
+private:
+	void flush_(bool into_layer) {
+		sort_();
+		build_batches_();
+
+		stats_ = {cmds_.size(), batches_.size(), 0, 0, 0, std::exchange(culled_, 0)};
+
+		if (!batches_.empty()) {
+			vbo_.upload(sorted_verts_.data(),
+					sorted_verts_.size() * sizeof(gl::vertex),
+					GL_DYNAMIC_DRAW);
+			execute_(into_layer);
+		}
+
+		cmds_.clear();
+		verts_.clear();
+	}
+
+	struct command {
+		uint64_t key;
+		uint32_t first;
+		uint32_t count;
+		glm::vec4 color;
+		uint8_t palette;
+		gl::program *prog;
+		const gl::texture2d *tex;
+	};
+
+	struct sort_item {
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// LSD radix sort, one byte per pass. Passes where every key has the same
+	// byte are skipped, which in practice leaves only a few of them.
+	void sort_() {
+		size_t n = cmds_.size();
+		order_.resize(n);
+		scratch_.resize(n);
+
+		for (size_t i = 0; i < n; i++)
+			order_[i] = {cmds_[i].key, static_cast<uint32_t>(i)};
+
+		if (n < 2)
+			return;
+
+		for (int shift = 0; shift < 64; shift += 8) {
+			std::array<uint32_t, 256> offsets{};
+			for (auto &item : order_)
+				offsets[(item.key >> shift) & 0xFF]++;
+
+			if (offsets[(order_[0].key >> shift) & 0xFF] == n)
+				continue;
+
+			uint32_t sum = 0;
+			for (auto &off : offsets)
+				sum += std::exchange(off, sum);
+
+			for (auto &item : order_)
+				scratch_[offsets[(item.key >> shift) & 0xFF]++] = item;
+
+			std::swap(order_, scratch_);
+		}
+	}
+
+	// Lays out the vertices in execution order so that consecutive commands
+	// with identical state end up as a single draw call.
+	void build_batches_() {
+		batches_.clear();
+		sorted_verts_.clear();
+
+		for (auto &item : order_) {
+			auto &cmd = cmds_[item.index];
+			auto first = static_cast<uint32_t>(sorted_verts_.size());
+
+			sorted_verts_.insert(sorted_verts_.end(),
+					verts_.begin() + cmd.first,
+					verts_.begin() + cmd.first + cmd.count);
+
+			if (!batches_.empty()) {
+				auto &last = batches_.back();
+				if (state_of(last.key) == state_of(cmd.key)
+						&& last.prog == cmd.prog
+						&& last.tex == cmd.tex
+						&& last.color == cmd.color
+						&& last.palette == cmd.palette) {
+					last.count += cmd.count;
+					continue;
+				}
+			}
+
+			batches_.push_back({cmd.key, first, cmd.count, cmd.color, cmd.palette, cmd.prog, cmd.tex});
+		}
+	}
+
+	void execute_(bool into_layer) {
+		gl::program *cur_prog = nullptr;
+		const gl::texture2d *cur_tex = nullptr;
+		bool cur_screen = false;
+		bool have_blend = false;
+		blend_mode cur_blend = blend_mode::opaque;
+		glm::vec4 cur_color{-1, -1, -1, -1};
+		int cur_palette = -1;
+
+		vbo_.bind();
+
+		for (auto &b : batches_) {
+			bool screen = is_screen_space(layer_of(b.key));
+
+			if (b.prog != cur_prog) {
+				cur_prog = b.prog;
+				cur_prog->use();
+				cur_prog->set_uniform("obj_pos", glm::vec2{0, 0});
+				cur_prog->set_uniform("ortho", screen ? screen_view_ : world_view_);
+				cur_prog->set_uniform("palette_sampler", 1);
+				cur_screen = screen;
+				cur_color = {-1, -1, -1, -1};
+				cur_palette = -1;
+				stats_.program_changes++;
+			} else if (screen != cur_screen) {
+				cur_prog->set_uniform("ortho", screen ? screen_view_ : world_view_);
+				cur_screen = screen;
+			}
+
+			auto blend = blend_of(b.key);
+			if (!have_blend || blend != cur_blend) {
+				if (blend == blend_mode::alpha) {
+					glEnable(GL_BLEND);
+					if (into_layer)
+						glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+								GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+					else
+						glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				} else if (blend == blend_mode::premultiplied) {
+					glEnable(GL_BLEND);
+					glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+				} else {
+					glDisable(GL_BLEND);
+				}
+				have_blend = true;
+				cur_blend = blend;
+				stats_.blend_changes++;
+			}
+
+			if (b.tex != cur_tex) {
+				cur_tex = b.tex;
+				cur_tex->bind();
+				stats_.texture_changes++;
+			}
+
+			if (b.color != cur_color) {
+				cur_color = b.color;
+				cur_prog->set_uniform("obj_color", cur_color);
+			}
+
+			if (b.tex->indexed() && b.palette != cur_palette) {
+				cur_palette = b.palette;
+				cur_prog->set_uniform("palette_row", static_cast<float>(cur_palette));
+			}
+
+			glDrawArrays(GL_TRIANGLES, b.first, b.count);
+		}
+	}
+
+	std::vector<command> cmds_;
+	std::vector<gl::vertex> verts_;
+
+	std::vector<sort_item> order_;
+	std::vector<sort_item> scratch_;
+	std::vector<command> batches_;
+	std::vector<gl::vertex> sorted_verts_;
+
+	gl::vertex_buffer vbo_;
+	stats stats_{};
+	size_t culled_ = 0;
+
+	const camera *cam_ = nullptr;
+	glm::mat4 world_view_{1};
+	glm::mat4 screen_view_{1};
+};
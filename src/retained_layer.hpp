@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <GLES2/gl2.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <gl/framebuffer.hpp>
+#include <gl/shader.hpp>
+#include <gl/vertex.hpp>
+#include <render_queue.hpp>
+
+// Keep rarely changing layers in their own textures, when disabled they're
+// submitted straight into the frame every time.
+inline constexpr bool retain_static_layers = true;
+
+// A w by h cache of everything submitted between begin() and end(), which
+// is only redrawn after being marked dirty. Each frame it costs a single
+// quad in the layer it was created for. Both world and screen coordinates
+// map 1:1 onto it, a screen-sized layer holds screen space content and a
+// world-sized one world space content, which the camera then moves.
+struct retained_layer {
+	retained_layer(gl::program &prog, layer slot, int w, int h)
+	: prog_{&prog}, slot_{slot} {
+		target_.create(w, h);
+
+		auto view = glm::ortho(0.f, static_cast<float>(w), static_cast<float>(h), 0.f);
+		queue_.set_views(view, view);
+
+		quad_ = target_.quad();
+	}
+
+	retained_layer(const retained_layer &) = delete;
+	retained_layer &operator=(const retained_layer &) = delete;
+
+	void mark_dirty() {
+		dirty_ = true;
+	}
+
+	bool dirty() const {
+		return dirty_ || !retain_static_layers;
+	}
+
+	// Returns the queue the layer contents should be submitted into.
+	render_queue &begin(render_queue &frame) {
+		if constexpr (!retain_static_layers)
+			return frame;
+
+		return queue_;
+	}
+
+	void end() {
+		if constexpr (!retain_static_layers)
+			return;
+
+		// Whoever renders the frame may have its own target bound.
+		GLint prev_fb, prev_vp[4];
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fb);
+		glGetIntegerv(GL_VIEWPORT, prev_vp);
+
+		target_.bind();
+		glClearColor(0, 0, 0, 0);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		queue_.flush_into_layer();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, prev_fb);
+		glViewport(prev_vp[0], prev_vp[1], prev_vp[2], prev_vp[3]);
+
+		dirty_ = false;
+	}
+
+	void composite(render_queue &frame) {
+		if constexpr (!retain_static_layers)
+			return;
+
+		frame.submit(slot_, blend_mode::premultiplied, *prog_, target_.color(),
+				quad_.data(), quad_.size(), {0, 0}, {1, 1, 1, 1});
+	}
+
+	const render_queue::stats &last_stats() const {
+		return queue_.last_stats();
+	}
+
+private:
+	gl::program *prog_;
+	layer slot_;
+
+	gl::framebuffer target_;
+	std::array<gl::vertex, 6> quad_;
+	render_queue queue_;
+	bool dirty_ = true;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+#include <stdint.h>
+#include <snapshot.hpp>
+
+// Record every gameplay tick, holding backspace plays them back in reverse.
+inline constexpr bool record_rewind = true;
+inline constexpr int rewind_seconds = 5;
+
+// The last few seconds of snapshots, one per tick. Every keyframe_every-th
+// record (or one whose delta isn't worth it) is stored whole, the rest as
+// deltas against the keyframe before them. Slots keep their buffers when
+// overwritten, so recording stops allocating once they've grown.
+struct rewind_buffer {
+	rewind_buffer(size_t capacity, size_t keyframe_every)
+	: slots_(capacity), keyframe_every_{keyframe_every} { }
+
+	void record(const std::vector<uint8_t> &snapshot) {
+		if (count_ == slots_.size())
+			drop_oldest_();
+
+		auto key = latest_key_();
+		auto &slot = at_(count_);
+		slot.size = snapshot.size();
+		slot.key = !key || count_ - *key >= keyframe_every_;
+
+		if (!slot.key) {
+			encode_delta(at_(*key).bytes, snapshot, slot.bytes);
+			slot.key = slot.bytes.size() > snapshot.size() / 2;
+		}
+
+		if (slot.key)
+			slot.bytes.assign(snapshot.begin(), snapshot.end());
+
+		count_++;
+	}
+
+	// Reconstructs the snapshot recorded back records ago, 0 being the latest.
+	bool restore(size_t back, std::vector<uint8_t> &out) const {
+		if (back >= count_)
+			return false;
+
+		size_t i = count_ - 1 - back;
+		size_t key = i;
+		while (!at_(key).key)
+			key--;
+
+		auto &slot = at_(i);
+		if (key == i) {
+			out.assign(slot.bytes.begin(), slot.bytes.end());
+			return true;
+		}
+
+		return decode_delta(at_(key).bytes, slot.bytes, slot.size, out);
+	}
+
+	// Forgets the latest n records, to carry on recording from a restored one.
+	void drop_latest(size_t n) {
+		count_ -= std::min(n, count_);
+	}
+
+	void clear() {
+		count_ = 0;
+	}
+
+	size_t size() const {
+		return count_;
+	}
+
+	size_t capacity() const {
+		return slots_.size();
+	}
+
+	size_t bytes() const {
+		size_t n = 0;
+		for (auto &slot : slots_)
+			n += slot.bytes.capacity();
+		return n;
+	}
+
+private:
+	struct slot {
+		std::vector<uint8_t> bytes;
+		size_t size = 0;
+		bool key = false;
+	};
+
+	// i counts from the oldest record.
+	slot &at_(size_t i) {
+		return slots_[(head_ + i) % slots_.size()];
+	}
+
+	const slot &at_(size_t i) const {
+		return slots_[(head_ + i) % slots_.size()];
+	}
+
+	std::optional<size_t> latest_key_() const {
+		for (size_t i = count_; i-- > 0;)
+			if (at_(i).key)
+				return i;
+		return std::nullopt;
+	}
+
+	// Deltas can't outlive their keyframe, they're dropped along with it.
+	void drop_oldest_() {
+		do {
+			head_ = (head_ + 1) % slots_.size();
+			count_--;
+		} while (count_ && !at_(0).key);
+	}
+
+	std::vector<slot> slots_;
+	size_t keyframe_every_;
+	size_t head_ = 0;
+	size_t count_ = 0;
+};
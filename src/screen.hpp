@@ -0,0 +1,14 @@
+#pragma once
+
+// The native resolution, everything is rendered at this size and scaled up
+// by whoever presents it.
+struct screen {
+	static constexpr int width = 160;
+	static constexpr int height = 120;
+};
+
+struct frame_status {
+	bool changed; // differs from the last rendered frame
+	bool animating; // expected to change every frame
+	bool steady; // settled gameplay, which shouldn't allocate anymore
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Just enough of a float vector type for the bulk mover kernels. Maps to
+// simd128 under Emscripten (with -Dsimd=true), to AVX when the compiler
+// may use it and SSE2 otherwise, with a plain loop everywhere else.
+namespace simd {
+
+#if defined(__wasm_simd128__)
+
+inline constexpr size_t lanes = 4;
+
+struct f32 { v128_t v; };
+struct mask { v128_t v; };
+
+inline f32 load(const float *p) { return {wasm_v128_load(p)}; }
+inline void store(float *p, f32 a) { wasm_v128_store(p, a.v); }
+inline f32 splat(float s) { return {wasm_f32x4_splat(s)}; }
+
+inline f32 operator+(f32 a, f32 b) { return {wasm_f32x4_add(a.v, b.v)}; }
+inline f32 operator-(f32 a, f32 b) { return {wasm_f32x4_sub(a.v, b.v)}; }
+inline f32 operator*(f32 a, f32 b) { return {wasm_f32x4_mul(a.v, b.v)}; }
+
+inline mask operator<(f32 a, f32 b) { return {wasm_f32x4_lt(a.v, b.v)}; }
+inline mask operator<=(f32 a, f32 b) { return {wasm_f32x4_le(a.v, b.v)}; }
+inline mask operator>(f32 a, f32 b) { return {wasm_f32x4_gt(a.v, b.v)}; }
+inline mask operator>=(f32 a, f32 b) { return {wasm_f32x4_ge(a.v, b.v)}; }
+
+inline mask operator&(mask a, mask b) { return {wasm_v128_and(a.v, b.v)}; }
+inline mask operator|(mask a, mask b) { return {wasm_v128_or(a.v, b.v)}; }
+
+inline f32 select(mask m, f32 a, f32 b) { return {wasm_v128_bitselect(a.v, b.v, m.v)}; }
+inline uint32_t bits(mask m) { return wasm_i32x4_bitmask(m.v); }
+
+#elif defined(__AVX__)
+
+inline constexpr size_t lanes = 8;
+
+struct f32 { __m256 v; };
+struct mask { __m256 v; };
+
+inline f32 load(const float *p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float *p, f32 a) { _mm256_storeu_ps(p, a.v); }
+inline f32 splat(float s) { return {_mm256_set1_ps(s)}; }
+
+inline f32 operator+(f32 a, f32 b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline f32 operator-(f32 a, f32 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline f32 operator*(f32 a, f32 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+
+inline mask operator<(f32 a, f32 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline mask operator<=(f32 a, f32 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline mask operator>(f32 a, f32 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline mask operator>=(f32 a, f32 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+
+inline mask operator&(mask a, mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline mask operator|(mask a, mask b) { return {_mm256_or_ps(a.v, b.v)}; }
+
+inline f32 select(mask m, f32 a, f32 b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+inline uint32_t bits(mask m) { return _mm256_movemask_ps(m.v); }
+
+#elif defined(__SSE2__)
+
+inline constexpr size_t lanes = 4;
+
+struct f32 { __m128 v; };
+struct mask { __m128 v; };
+
+inline f32 load(const float *p) { return {_mm_loadu_ps(p)}; }
+inline void store(float *p, f32 a) { _mm_storeu_ps(p, a.v); }
+inline f32 splat(float s) { return {_mm_set1_ps(s)}; }
+
+inline f32 operator+(f32 a, f32 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline f32 operator-(f32 a, f32 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline f32 operator*(f32 a, f32 b) { return {_mm_mul_ps(a.v, b.v)}; }
+
+inline mask operator<(f32 a, f32 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline mask operator<=(f32 a, f32 b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline mask operator>(f32 a, f32 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline mask operator>=(f32 a, f32 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+
+inline mask operator&(mask a, mask b) { return {_mm_and_ps(a.v, b.v)}; }
+inline mask operator|(mask a, mask b) { return {_mm_or_ps(a.v, b.v)}; }
+
+// No blendv before SSE4.1.
+inline f32 select(mask m, f32 a, f32 b) {
+	return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))};
+}
+inline uint32_t bits(mask m) { return _mm_movemask_ps(m.v); }
+
+#else
+
+inline constexpr size_t lanes = 4;
+
+struct f32 { float v[lanes]; };
+struct mask { bool v[lanes]; };
+
+template <typename T, typename F>
+inline T each_(F &&fn) {
+	T r;
+	for (size_t i = 0; i < lanes; i++)
+		r.v[i] = fn(i);
+	return r;
+}
+
+inline f32 load(const float *p) { return each_<f32>([&] (size_t i) { return p[i]; }); }
+inline void store(float *p, f32 a) { std::copy_n(a.v, lanes, p); }
+inline f32 splat(float s) { return each_<f32>([&] (size_t) { return s; }); }
+
+inline f32 operator+(f32 a, f32 b) { return each_<f32>([&] (size_t i) { return a.v[i] + b.v[i]; }); }
+inline f32 operator-(f32 a, f32 b) { return each_<f32>([&] (size_t i) { return a.v[i] - b.v[i]; }); }
+inline f32 operator*(f32 a, f32 b) { return each_<f32>([&] (size_t i) { return a.v[i] * b.v[i]; }); }
+
+inline mask operator<(f32 a, f32 b) { return each_<mask>([&] (size_t i) { return a.v[i] < b.v[i]; }); }
+inline mask operator<=(f32 a, f32 b) { return each_<mask>([&] (size_t i) { return a.v[i] <= b.v[i]; }); }
+inline mask operator>(f32 a, f32 b) { return each_<mask>([&] (size_t i) { return a.v[i] > b.v[i]; }); }
+inline mask operator>=(f32 a, f32 b) { return each_<mask>([&] (size_t i) { return a.v[i] >= b.v[i]; }); }
+
+inline mask operator&(mask a, mask b) { return each_<mask>([&] (size_t i) { return a.v[i] && b.v[i]; }); }
+inline mask operator|(mask a, mask b) { return each_<mask>([&] (size_t i) { return a.v[i] || b.v[i]; }); }
+
+inline f32 select(mask m, f32 a, f32 b) {
+	return each_<f32>([&] (size_t i) { return m.v[i] ? a.v[i] : b.v[i]; });
+}
+
+inline uint32_t bits(mask m) {
+	uint32_t r = 0;
+	for (size_t i = 0; i < lanes; i++)
+		r |= m.v[i] << i;
+	return r;
+}
+
+#endif
+
+inline f32 &operator+=(f32 &a, f32 b) { return a = a + b; }
+inline f32 &operator-=(f32 &a, f32 b) { return a = a - b; }
+inline f32 &operator*=(f32 &a, f32 b) { return a = a * b; }
+
+// Partial versions for the last few elements of an array, n <= lanes.
+inline f32 load(const float *p, size_t n) {
+	if (n == lanes)
+		return load(p);
+
+	float buf[lanes]{};
+	std::copy_n(p, n, buf);
+	return load(buf);
+}
+
+inline void store(float *p, f32 a, size_t n) {
+	if (n == lanes)
+		return store(p, a);
+
+	float buf[lanes];
+	store(buf, a);
+	std::copy_n(buf, n, p);
+}
+
+// Calls fn(i, n) over [begin, end) in steps of lanes elements, n only falls
+// short of that on the last step.
+template <typename F>
+inline void for_each(size_t begin, size_t end, F &&fn) {
+	for (size_t i = begin; i < end; i += lanes)
+		fn(i, std::min(lanes, end - i));
+}
+
+// Removes elements from an SoA array in place without reordering the rest.
+// drop(i, n) returns the lanes to remove as bits, move(from, to) moves a
+// single element. Returns the new size.
+template <typename Drop, typename Move>
+inline size_t compact(size_t size, Drop &&drop, Move &&move) {
+	size_t out = 0;
+
+	for_each(0, size, [&] (size_t i, size_t n) {
+		auto dropped = drop(i, n) & ((1u << n) - 1);
+		if (!dropped && out == i) {
+			out += n;
+			return;
+		}
+
+		for (size_t l = 0; l < n; l++) {
+			if (dropped & (1u << l))
+				continue;
+			if (out != i + l)
+				move(i + l, out);
+			out++;
+		}
+	});
+
+	return out;
+}
+
+} // namespace simd
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+// Flat binary image of the simulation state, no GL objects. Values are
+// stored as raw bytes in a fixed order with variable-length data towards
+// the end, so snapshots of nearby ticks mostly line up byte for byte.
+struct snapshot_writer {
+	explicit snapshot_writer(std::vector<uint8_t> &out)
+	: out_{out} {
+		out_.clear();
+	}
+
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	void put(const T &val) {
+		auto bytes = reinterpret_cast<const uint8_t *>(&val);
+		out_.insert(out_.end(), bytes, bytes + sizeof(T));
+	}
+
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	void put_vector(const std::vector<T> &vals) {
+		put(static_cast<uint32_t>(vals.size()));
+		auto bytes = reinterpret_cast<const uint8_t *>(vals.data());
+		out_.insert(out_.end(), bytes, bytes + vals.size() * sizeof(T));
+	}
+
+private:
+	std::vector<uint8_t> &out_;
+};
+
+// Reading past the end leaves the value alone and marks the reader as
+// failed, callers only check once at the end.
+struct snapshot_reader {
+	snapshot_reader(const uint8_t *data, size_t size)
+	: data_{data}, size_{size} { }
+
+	explicit snapshot_reader(const std::vector<uint8_t> &data)
+	: snapshot_reader{data.data(), data.size()} { }
+
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	void get(T &val) {
+		if (!take_(sizeof(T)))
+			return;
+		std::memcpy(&val, data_ + pos_ - sizeof(T), sizeof(T));
+	}
+
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	T get() {
+		T val{};
+		get(val);
+		return val;
+	}
+
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	void get_vector(std::vector<T> &vals) {
+		auto n = get<uint32_t>();
+		if (!take_(n * sizeof(T)))
+			return;
+
+		vals.resize(n);
+		if (n)
+			std::memcpy(vals.data(), data_ + pos_ - n * sizeof(T), n * sizeof(T));
+	}
+
+	bool failed() const {
+		return failed_;
+	}
+
+	// Everything was read, and nothing more.
+	bool ok() const {
+		return !failed_ && pos_ == size_;
+	}
+
+private:
+	bool take_(size_t n) {
+		if (failed_ || size_ - pos_ < n) {
+			failed_ = true;
+			return false;
+		}
+
+		pos_ += n;
+		return true;
+	}
+
+	const uint8_t *data_;
+	size_t size_;
+	size_t pos_ = 0;
+	bool failed_ = false;
+};
+
+// Delta of a snapshot against a base one: the XOR of both, with runs of
+// zeroes (unchanged bytes) collapsed. Encoded as repeated
+// [u16 unchanged][u16 changed][changed XORed bytes], bytes past the end of
+// the base are XORed against zero. Runs shorter than a header are kept in
+// the changed bytes.
+inline void encode_delta(const std::vector<uint8_t> &base, const std::vector<uint8_t> &cur,
+		std::vector<uint8_t> &out) {
+	out.clear();
+
+	auto put16 = [&] (size_t v) {
+		out.push_back(v & 0xFF);
+		out.push_back(v >> 8);
+	};
+
+	auto x = [&] (size_t i) -> uint8_t {
+		return i < base.size() ? cur[i] ^ base[i] : cur[i];
+	};
+
+	size_t i = 0, n = cur.size();
+
+	auto unchanged_run = [&] (size_t at) {
+		size_t end = std::min(at + 4, n);
+		for (; at < end; at++)
+			if (x(at))
+				return false;
+		return true;
+	};
+
+	while (i < n) {
+		size_t same = 0;
+		while (i + same < n && same < 0xFFFF && !x(i + same))
+			same++;
+		i += same;
+
+		size_t diff = 0;
+		while (i + diff < n && diff < 0xFFFF && !unchanged_run(i + diff))
+			diff++;
+
+		put16(same);
+		put16(diff);
+		for (size_t j = 0; j < diff; j++)
+			out.push_back(x(i + j));
+		i += diff;
+	}
+}
+
+// Inverse of encode_delta, size is the length of the encoded snapshot.
+inline bool decode_delta(const std::vector<uint8_t> &base, const std::vector<uint8_t> &delta,
+		size_t size, std::vector<uint8_t> &out) {
+	out.resize(size);
+
+	size_t common = std::min(size, base.size());
+	std::copy_n(base.begin(), common, out.begin());
+	std::fill(out.begin() + common, out.end(), 0);
+
+	size_t i = 0, pos = 0;
+	while (pos + 4 <= delta.size()) {
+		size_t same = delta[pos] | (delta[pos + 1] << 8);
+		size_t diff = delta[pos + 2] | (delta[pos + 3] << 8);
+		pos += 4;
+
+		i += same;
+		if (i + diff > size || pos + diff > delta.size())
+			return false;
+
+		for (size_t j = 0; j < diff; j++)
+			out[i + j] ^= delta[pos + j];
+
+		i += diff;
+		pos += diff;
+	}
+
+	return pos == delta.size();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+enum class sound : uint8_t {
+	jump, hit, blockfall, gameover, pickup, shoot,
+	count
+};
+
+// Sounds the simulation triggered since they were last taken, whoever
+// presents the game decides how to play them. Any thread may trigger, and
+// the same sound triggered again before the next take() only counts once.
+struct sound_events {
+	void play(sound s) {
+		fired_.fetch_or(1u << static_cast<int>(s), std::memory_order_relaxed);
+	}
+
+	// One bit per sound.
+	uint32_t take() {
+		return fired_.exchange(0, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint32_t> fired_{0};
+};
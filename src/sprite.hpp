@@ -1,59 +1,174 @@
 #pragma once
 
 #include <array>
+#include <cassert>
+#include <vector>
 #include <gl/texture.hpp>
-#include <gl/mesh.hpp>
 #include <gl/shader.hpp>
+#include <render_queue.hpp>
 
-struct sprite {
-	sprite(gl::program &prog, const std::string &texture, int w, int h, int f = 0)
-	: mesh_{&prog}, w_{w}, h_{h}, frame_{f} {
-		tex_.load(texture);
-
-		vtx_ = std::array<gl::vertex, 6>{
-			gl::vertex{{0, 0}, {0, 0}},
-			gl::vertex{{w, 0}, {1, 0}},
-			gl::vertex{{w, h}, {1, 1}},
-
-			gl::vertex{{0, 0}, {0, 0}},
-			gl::vertex{{w, h}, {1, 1}},
-			gl::vertex{{0, h}, {0, 1}}
+// Texture coordinates of one frame of a sprite sheet.
+struct uv_rect {
+	glm::vec2 min, max;
+};
+
+// Selects the sprite_sheet constructor that only reads the layout of the
+// image, for simulating without a GL context.
+inline constexpr struct layout_only_t { } layout_only;
+
+// Everything shared by the sprites drawn from one image: the texture, the
+// frame size and the UV rectangle of every frame. Created once per asset,
+// sprites only point at it.
+struct sprite_sheet {
+	sprite_sheet(gl::program &prog, const std::string &texture, int w, int h,
+			gl::texture_format format = gl::texture_format::rgba)
+	: prog_{&prog}, w_{w}, h_{h} {
+		tex_.load(texture, format);
+		init_frames_(tex_.width(), tex_.height());
+	}
+
+	// Such a sheet can't be drawn from.
+	sprite_sheet(layout_only_t, const std::string &texture, int w, int h)
+	: prog_{nullptr}, w_{w}, h_{h} {
+		auto surf = IMG_Load(texture.data());
+		if (!surf) {
+			std::cerr << __func__ << ": failed to load \"" << texture << "\"" << std::endl;
+			assert(!"failed to load texture");
+			return;
+		}
+
+		init_frames_(surf->w, surf->h);
+		SDL_FreeSurface(surf);
+	}
+
+	sprite_sheet(const sprite_sheet &) = delete;
+	sprite_sheet &operator=(const sprite_sheet &) = delete;
+
+	// The frame is only resolved here, changing it never touches any
+	// geometry.
+	void render(render_queue &queue, layer l, int frame, int x, int y,
+			glm::vec4 tint, uint8_t palette) const {
+		if (!queue.visible(l, x, y, w_, h_))
+			return;
+
+		auto &uv = frames_[frame];
+		std::array<gl::vertex, 6> vtx{
+			gl::vertex{quad_[0], {uv.min.x, uv.min.y}},
+			gl::vertex{quad_[1], {uv.max.x, uv.min.y}},
+			gl::vertex{quad_[2], {uv.max.x, uv.max.y}},
+
+			gl::vertex{quad_[3], {uv.min.x, uv.min.y}},
+			gl::vertex{quad_[4], {uv.max.x, uv.max.y}},
+			gl::vertex{quad_[5], {uv.min.x, uv.max.y}}
 		};
 
-		set_frame(frame_);
+		queue.submit(l, blend_mode::alpha, *prog_, tex_,
+				vtx.data(), vtx.size(), glm::vec2{x, y}, tint, 0, palette);
 	}
 
-	sprite(const sprite &) = delete;
-	sprite &operator=(const sprite &) = delete;
-	sprite(sprite &&) = default;
-	sprite &operator=(sprite &&) = default;
+	int frame_count() const {
+		return frames_.size();
+	}
 
-	void render() {
-		tex_.bind();
-		mesh_.program()->set_uniform("obj_pos", glm::vec2{x, y});
-		mesh_.program()->set_uniform("obj_color", glm::vec4{1, 1, 1, 1});
-		mesh_.render();
+	int width() const {
+		return w_;
 	}
 
-	void set_frame(int frame) {
-		frame_ = frame;
+	int height() const {
+		return h_;
+	}
+
+	// Palette swaps only work with indexed sheets.
+	const gl::texture2d &texture() const {
+		return tex_;
+	}
+
+	int add_palette(const gl::palette &colors) {
+		return tex_.add_palette(colors);
+	}
+
+private:
+	void init_frames_(int tex_w, int tex_h) {
+		int per_x = tex_w / w_;
+		int per_y = tex_h / h_;
+		float tw = w_ / static_cast<float>(tex_w);
+		float th = h_ / static_cast<float>(tex_h);
+
+		frames_.reserve(per_x * per_y);
+		for (int i = 0; i < per_x * per_y; i++) {
+			glm::vec2 min{(i % per_x) * tw, (i / per_x) * th};
+			frames_.push_back({min, min + glm::vec2{tw, th}});
+		}
+
+		float fw = w_, fh = h_;
+		quad_ = {
+			glm::vec2{0, 0}, glm::vec2{fw, 0}, glm::vec2{fw, fh},
+			glm::vec2{0, 0}, glm::vec2{fw, fh}, glm::vec2{0, fh}
+		};
+	}
+
+	std::vector<uv_rect> frames_;
+	std::array<glm::vec2, 6> quad_;
+	gl::texture2d tex_;
+	gl::program *prog_;
+
+	int w_, h_;
+};
+
+// Sprites recorded to be drawn later, possibly on another thread. Only the
+// sheets are referenced, they have to outlive the list.
+struct draw_list {
+	void add(const sprite_sheet &sheet, layer l, int frame, int x, int y,
+			glm::vec4 tint, uint8_t palette) {
+		items_.push_back({&sheet, l, frame, x, y, tint, palette});
+	}
+
+	void replay(render_queue &queue) const {
+		for (auto &i : items_)
+			i.sheet->render(queue, i.l, i.frame, i.x, i.y, i.tint, i.palette);
+	}
+
+	void clear() {
+		items_.clear();
+	}
+
+	size_t size() const {
+		return items_.size();
+	}
+
+private:
+	struct item {
+		const sprite_sheet *sheet;
+		layer l;
+		int frame;
+		int x, y;
+		glm::vec4 tint;
+		uint8_t palette;
+	};
+
+	std::vector<item> items_;
+};
 
-		int per_x = tex_.width() / w_;
+// One placement of a frame of a sheet, cheap to copy and store in bulk.
+struct sprite {
+	sprite() = default;
 
-		float tx = ((frame % per_x) * w_) / static_cast<float>(tex_.width());
-		float ty = ((frame / per_x) * h_) / static_cast<float>(tex_.height());
+	sprite(const sprite_sheet &sheet, int f = 0)
+	: sheet_{&sheet}, frame_{f} {
+		assert(frame_ < sheet.frame_count());
+	}
 
-		float tw = tx + w_ / static_cast<float>(tex_.width());
-		float th = ty + h_ / static_cast<float>(tex_.height());
+	void render(render_queue &queue, layer l) const {
+		sheet_->render(queue, l, frame_, x, y, tint, palette);
+	}
 
-		vtx_[0].tex = {tx, ty};
-		vtx_[1].tex = {tw, ty};
-		vtx_[2].tex = {tw, th};
-		vtx_[3].tex = {tx, ty};
-		vtx_[4].tex = {tw, th};
-		vtx_[5].tex = {tx, th};
+	void render(draw_list &list, layer l) const {
+		list.add(*sheet_, l, frame_, x, y, tint, palette);
+	}
 
-		mesh_.vbo().store_regenerate(vtx_.data(), vtx_.size() * sizeof(gl::vertex), GL_STATIC_DRAW);
+	void set_frame(int frame) {
+		assert(frame >= 0 && frame < sheet_->frame_count());
+		frame_ = frame;
 	}
 
 	int get_frame() const {
@@ -61,12 +176,10 @@ struct sprite {
 	}
 
 	int x = 0, y = 0;
+	glm::vec4 tint{1, 1, 1, 1};
+	uint8_t palette = 0;
 
 private:
-	std::array<gl::vertex, 6> vtx_{};
-	gl::texture2d tex_;
-	gl::mesh mesh_;
-
-	int w_, h_;
-	int frame_;
+	const sprite_sheet *sheet_ = nullptr;
+	int frame_ = 0;
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+
+// Bounded FIFO between exactly one pushing and one popping thread, neither
+// side ever waits or allocates. push() fails when the queue is full.
+template <typename T, size_t N> requires (N > 0 && (N & (N - 1)) == 0)
+struct spsc_queue {
+	bool push(const T &val) {
+		auto tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_.load(std::memory_order_acquire) == N)
+			return false;
+
+		slots_[tail % N] = val;
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T &val) {
+		auto head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+
+		val = slots_[head % N];
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::array<T, N> slots_{};
+
+	// Apart so that both sides don't keep stealing the same cache line.
+	alignas(64) std::atomic<size_t> head_{0};
+	alignas(64) std::atomic<size_t> tail_{0};
+};
@@ -3,15 +3,17 @@
 #include <string_view>
 #include <iostream>
 #include <fstream>
-#include <gl/mesh.hpp>
+#include <vector>
 #include <gl/texture.hpp>
+#include <gl/shader.hpp>
+#include <render_queue.hpp>
 
 struct text;
 
 struct font {
 	friend struct text;
 
-	font(const std::string &resource) {
+	font(const std::string &resource, gl::texture_format format = gl::texture_format::rgba) {
 		std::ifstream res{resource};
 		if (!res) {
 			std::cerr << "Cannot open font resource \"" << resource << "\"\n";
@@ -23,7 +25,7 @@ struct font {
 
 		res >> char_w_ >> char_h_ >> chars_per_atlas_line_;
 
-		atlas_.load(path);
+		atlas_.load(path, format);
 
 		std::cout << "Loaded font \"" << path << "\" with metrics " << char_w_ << " " << char_h_ << " " << chars_per_atlas_line_ << "\n";
 	}
@@ -37,19 +39,16 @@ private:
 
 struct text {
 	text(gl::program &prog, font &font)
-	: font_{&font}, mesh_{&prog} {}
+	: font_{&font}, prog_{&prog} {}
 
 	void set_text(std::string_view str) {
-		n_chars_ = 0;
+		size_t n_chars = 0;
 
 		for (char c : str)
 			if (c && c != '\n' && c != ' ')
-				n_chars_++;
+				n_chars++;
 
-		size_t new_size = n_chars_ * 6;
-
-		std::vector<gl::vertex> verts;
-		verts.resize(new_size);
+		verts_.resize(n_chars * 6);
 
 		int x = 0, y = 0;
 		size_t i = 0;
@@ -74,31 +73,27 @@ struct text {
 
 			int w = x + font_->char_w_, h = y + font_->char_h_;
 
-			verts[i++] = {{x, y}, {tx, ty}};
-			verts[i++] = {{w, y}, {tw, ty}};
-			verts[i++] = {{w, h}, {tw, th}};
+			verts_[i++] = {{x, y}, {tx, ty}};
+			verts_[i++] = {{w, y}, {tw, ty}};
+			verts_[i++] = {{w, h}, {tw, th}};
 
-			verts[i++] = {{x, y}, {tx, ty}};
-			verts[i++] = {{w, h}, {tw, th}};
-			verts[i++] = {{x, h}, {tx, th}};
+			verts_[i++] = {{x, y}, {tx, ty}};
+			verts_[i++] = {{w, h}, {tw, th}};
+			verts_[i++] = {{x, h}, {tx, th}};
 
 			x += font_->char_w_;
 		}
-
-		mesh_.vbo().upload(verts.data(), new_size * sizeof(gl::vertex), GL_STATIC_DRAW);
 	}
 
-	void render(glm::vec4 color) {
-		font_->atlas_.bind();
-		mesh_.program()->set_uniform("obj_pos", glm::vec2{x, y});
-		mesh_.program()->set_uniform("obj_color", color);
-		mesh_.render(n_chars_ * 6);
+	void render(render_queue &queue, layer l, glm::vec4 color) {
+		queue.submit(l, blend_mode::alpha, *prog_, font_->atlas_,
+				verts_.data(), verts_.size(), glm::vec2{x, y}, color);
 	}
 
 	int x = 0, y = 0;
 
 private:
 	font *font_;
-	gl::mesh mesh_;
-	size_t n_chars_;
+	gl::program *prog_;
+	std::vector<gl::vertex> verts_;
 };
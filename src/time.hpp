@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <map>
+#include <snapshot.hpp>
 
 struct alarm {
 	alarm(uint64_t id, double deadline)
@@ -23,6 +24,14 @@ struct alarm {
 		time_ = 0;
 	}
 
+	void save(snapshot_writer &w) const {
+		w.put(time_);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(time_);
+	}
+
 private:
 	uint64_t id_;
 	double deadline_;
@@ -46,6 +55,19 @@ struct time_tracker {
 		return elapsed_;
 	}
 
+	// Alarms are only ever added at startup, so only their progress is kept.
+	void save(snapshot_writer &w) const {
+		w.put(elapsed_);
+		for (auto &[_, alarm] : alarms_)
+			alarm.save(w);
+	}
+
+	void load(snapshot_reader &r) {
+		r.get(elapsed_);
+		for (auto &[_, alarm] : alarms_)
+			alarm.load(r);
+	}
+
 private:
 	uint64_t id_ = 0;
 	std::map<uint64_t, alarm> alarms_;
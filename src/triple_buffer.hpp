@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+// Hands the latest of a stream of values from one thread to another without
+// either side ever waiting. The writer fills back() and publishes it, the
+// reader picks up whatever was published last with acquire() and reads it
+// through front(). Values in between may be skipped, and the slots are
+// reused as they are, so whatever they allocated stays around.
+template <typename T>
+struct triple_buffer {
+	T &back() {
+		return slots_[back_];
+	}
+
+	// Writer side, swaps the back slot with the middle one.
+	void publish() {
+		back_ = middle_.exchange(back_ | fresh_bit, std::memory_order_acq_rel) & index_mask;
+	}
+
+	// Reader side, returns whether front() changed.
+	bool acquire() {
+		if (!(middle_.load(std::memory_order_relaxed) & fresh_bit))
+			return false;
+
+		front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+		return true;
+	}
+
+	const T &front() const {
+		return slots_[front_];
+	}
+
+private:
+	static constexpr uint8_t index_mask = 3;
+	static constexpr uint8_t fresh_bit = 4;
+
+	std::array<T, 3> slots_{};
+	uint8_t back_ = 0;
+	std::atomic<uint8_t> middle_{1};
+	uint8_t front_ = 2;
+};
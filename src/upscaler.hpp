@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <gl/framebuffer.hpp>
+#include <gl/mesh.hpp>
+#include <gl/shader.hpp>
+
+// Renders at the native resolution into an offscreen target, which is then
+// stretched onto the screen with a single nearest-neighbour quad.
+struct upscaler {
+	upscaler(int w, int h)
+	: quad_{&prog_}, ortho_{glm::ortho(0.f, static_cast<float>(w), static_cast<float>(h), 0.f)} {
+		target_.create(w, h);
+
+		auto vtx = target_.quad();
+		quad_.vbo().store_regenerate(vtx.data(), vtx.size() * sizeof(gl::vertex), GL_STATIC_DRAW);
+	}
+
+	upscaler(const upscaler &) = delete;
+	upscaler &operator=(const upscaler &) = delete;
+
+	void begin() {
+		target_.bind();
+	}
+
+	void present(int out_w, int out_h) {
+		gl::framebuffer::unbind();
+		glViewport(0, 0, out_w, out_h);
+		glDisable(GL_BLEND);
+
+		target_.color().bind();
+		quad_.vbo().bind();
+		prog_.use();
+		prog_.set_uniform("ortho", ortho_);
+		prog_.set_uniform("obj_pos", glm::vec2{0, 0});
+		prog_.set_uniform("obj_color", glm::vec4{1, 1, 1, 1});
+		quad_.render();
+	}
+
+private:
+	gl::program prog_{
+		gl::shader{GL_VERTEX_SHADER, "res/shaders/generic-vertex.glsl"},
+		gl::shader{GL_FRAGMENT_SHADER, "res/shaders/generic-fragment.glsl"}
+	};
+
+	gl::framebuffer target_;
+	gl::mesh quad_;
+	glm::mat4 ortho_;
+};
@@ -4,24 +4,49 @@
 #include <emscripten/html5.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengles2.h>
-#include <map>
-#include <set>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <alloc_track.hpp>
+#include <frame_arena.hpp>
+#include <input.hpp>
+#include <jobs.hpp>
+#include <quality.hpp>
+#include <screen.hpp>
+#include <spsc_queue.hpp>
+#include <upscaler.hpp>
 
 // #define LOG_SCALE
 //
 inline constexpr bool log_scale = false;
 
-struct input_state {
-	int mouse_x, mouse_y;
-	std::map<SDL_Keycode, bool> down_keys;
-	std::set<SDL_Keycode> just_pressed_keys;
-};
+// Skip redrawing frames the renderer reports as unchanged, and tick at
+// idle_tick_rate while it isn't animating.
+inline constexpr bool elide_idle_frames = true;
+inline constexpr int idle_tick_rate = 15;
+
+// Render at the native resolution and upscale the result once, instead of
+// rasterizing everything at the scaled resolution. F2 toggles it at runtime.
+inline constexpr bool render_offscreen = true;
+inline constexpr bool log_render_mode = false;
+
+// Tick on a thread of its own when there are threads, so that a slow tick
+// doesn't hold up presenting and a slow present doesn't hold up ticking.
+// The renderer then draws whatever the last tick published.
+inline constexpr bool threaded_simulation = jobs_have_threads;
+inline constexpr int sim_tick_rate = 60;
+
+inline alloc_zone tick_alloc_zone{"tick"};
+inline alloc_zone render_alloc_zone{"render"};
 
 struct window {
-	static constexpr int width = 160;
-	static constexpr int height = 120;
+	static constexpr int width = screen::width;
+	static constexpr int height = screen::height;
 
 	window() {
 		SDL_Init(SDL_INIT_VIDEO);
@@ -55,6 +80,11 @@ struct window {
 		ctx_ = SDL_GL_CreateContext(wnd_);
 		glViewport(0, 0, width * scale_, height * scale_);
 
+		upscaler_.emplace(width, height);
+
+		input_.time_frequency = SDL_GetPerformanceFrequency();
+		SDL_AddEventWatch(stamp_key_event_, this);
+
 		emscripten_set_resize_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, this, false,
 		[] (int, const EmscriptenUiEvent *ui_ev, void *ctx) -> int {
 			auto wnd = static_cast<window *>(ctx);
@@ -75,6 +105,7 @@ struct window {
 
 			SDL_SetWindowSize(wnd->wnd_, width * wnd->scale_, height * wnd->scale_);
 			glViewport(0, 0, width * wnd->scale_, height * wnd->scale_);
+			wnd->force_redraw_ = true;
 
 			return true;
 		});
@@ -94,47 +125,134 @@ struct window {
 		renderer_cb_ = [] (void *ctx) {
 			static_cast<T *>(ctx)->render();
 		};
+		status_cb_ = [] (void *ctx) {
+			return static_cast<T *>(ctx)->status();
+		};
+		quality_cb_ = [] (void *ctx, const quality_report &report) {
+			static_cast<T *>(ctx)->set_quality(report);
+		};
 	}
 
 	void enter_main_loop() {
 		last_ticks_ = SDL_GetTicks();
+
+		if constexpr (threaded_simulation) {
+			running_ = true;
+			sim_thread_ = std::thread{[this] { sim_loop_(); }};
+		}
+
 		emscripten_set_main_loop_arg([] (void *ctx) {
 			static_cast<window *>(ctx)->main_loop();
 		}, this, 0, true);
 	}
 
 	void main_loop() {
+		auto frame_start = std::chrono::steady_clock::now();
+
 		auto now_ticks = SDL_GetTicks();
 		auto delta = static_cast<double>(now_ticks - last_ticks_) / 1000.0;
 		last_ticks_ = now_ticks;
 
-		input_.just_pressed_keys.clear();
+		frame_memory().reset();
+		allocs_.begin_frame(steady_);
+		if constexpr (!threaded_simulation)
+			input_.begin_frame();
 
 		SDL_Event ev;
 		while (SDL_PollEvent(&ev)) {
 			switch (ev.type) {
 				case SDL_KEYUP:
-					input_.down_keys[ev.key.keysym.sym] = false;
+					key_event_(ev.key, false);
 					break;
 				case SDL_KEYDOWN:
-					if (!input_.down_keys[ev.key.keysym.sym])
-						input_.just_pressed_keys.insert(ev.key.keysym.sym);
-					input_.down_keys[ev.key.keysym.sym] = true;
+					if (ev.key.keysym.scancode == SDL_SCANCODE_F2 && !ev.key.repeat) {
+						offscreen_ = !offscreen_;
+						force_redraw_ = true;
+						if constexpr (log_render_mode)
+							std::cout << "Rendering " << (offscreen_ ? "offscreen" : "directly")
+								<< " at scale " << scale_ << "\n";
+					}
+
+					if (ev.key.keysym.scancode == SDL_SCANCODE_F3 && !ev.key.repeat) {
+						show_stats_ = !show_stats_;
+						force_redraw_ = true;
+					}
+
+					key_event_(ev.key, true);
 					break;
 			}
 		}
 
-		ticker_cb_(delta, input_, ticker_ctx_);
+		if constexpr (!threaded_simulation) {
+			alloc_scope scope{tick_alloc_zone};
+			auto tick_start = std::chrono::steady_clock::now();
+			ticker_cb_(delta, input_, ticker_ctx_);
+			tick_ms_ = ms_since_(tick_start);
+		}
+
+		auto status = status_cb_(renderer_ctx_);
+		steady_ = status.steady;
+
+		if constexpr (elide_idle_frames) {
+			set_idle_(!status.animating);
+
+			// The canvas keeps showing the last frame we drew, so there is
+			// nothing to present.
+			if (!status.changed && !force_redraw_) {
+				allocs_.end_frame();
+				return;
+			}
+		}
+
+		force_redraw_ = false;
+
+		auto report = governor_.report();
+		report.visible = show_stats_;
+		quality_cb_(renderer_ctx_, report);
+
+		bool offscreen = offscreen_ || governor_.knobs().force_offscreen;
+		if (offscreen)
+			upscaler_->begin();
+		else
+			glViewport(0, 0, width * scale_, height * scale_);
 
 		glClearColor(0.364f, 0.737f, 0.823f, 1.f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		renderer_cb_(renderer_ctx_);
+		{
+			alloc_scope scope{render_alloc_zone};
+			renderer_cb_(renderer_ctx_);
+		}
+
+		if (offscreen)
+			upscaler_->present(width * scale_, height * scale_);
+
+		// Only frames that drew something count, an idle one costs nothing.
+		if (governor_.add_frame(ms_since_(frame_start), tick_ms_)) {
+			force_redraw_ = true;
+			if constexpr (log_quality_changes)
+				std::cout << "Quality level " << governor_.level()
+					<< " (frame " << governor_.report().frame_ms << " ms, tick "
+					<< governor_.report().tick_ms << " ms)\n";
+		}
 
 		SDL_GL_SwapWindow(wnd_);
+		allocs_.end_frame();
 	}
 
 	~window() {
+		if (sim_thread_.joinable()) {
+			{
+				std::lock_guard lock{pending_mutex_};
+				running_ = false;
+			}
+			wake_sim_.notify_one();
+			sim_thread_.join();
+		}
+
+		SDL_DelEventWatch(stamp_key_event_, this);
+
+		upscaler_.reset();
 		SDL_GL_DeleteContext(ctx_);
 		SDL_DestroyWindow(wnd_);
 		SDL_Quit();
@@ -147,16 +265,166 @@ struct window {
 	window &operator=(window &&) = delete;
 
 private:
+	// Called by SDL as events come in, which in the browser is as soon as
+	// it dispatches them rather than once per frame.
+	static int stamp_key_event_(void *ctx, SDL_Event *ev) {
+		if (ev->type != SDL_KEYDOWN && ev->type != SDL_KEYUP)
+			return 0;
+
+		static_cast<window *>(ctx)->key_stamps_.push({ev->key.type, ev->key.timestamp,
+				ev->key.keysym.scancode, SDL_GetPerformanceCounter()});
+		return 0;
+	}
+
+	// Events reach the queue in the order they were stamped, a stamp that
+	// doesn't match belongs to one SDL dropped.
+	uint64_t arrival_time_(const SDL_KeyboardEvent &key) {
+		key_stamp s;
+		while (key_stamps_.pop(s))
+			if (s.type == key.type && s.timestamp == key.timestamp && s.key == key.keysym.scancode)
+				return s.counter;
+
+		return SDL_GetPerformanceCounter();
+	}
+
+	// Stamped with the time the event arrived rather than the time we got
+	// to it, so events within one frame stay apart.
+	void key_event_(const SDL_KeyboardEvent &key, bool down) {
+		input_event ev{arrival_time_(key), key.keysym.scancode, down};
+
+		if constexpr (threaded_simulation) {
+			{
+				std::lock_guard lock{pending_mutex_};
+				pending_input_.push(ev);
+			}
+			wake_sim_.notify_one();
+		} else if (down) {
+			input_.key_down(ev.key, ev.time);
+		} else {
+			input_.key_up(ev.key, ev.time);
+		}
+	}
+
+	// Ticks at a fixed rate, catching up on time rather than ticks when it
+	// falls behind. While idle it ticks at idle_tick_rate instead, but a key
+	// press doesn't wait for the next slow tick.
+	void sim_loop_() {
+		using clock = std::chrono::steady_clock;
+		constexpr auto step = std::chrono::duration_cast<clock::duration>(
+				std::chrono::duration<double>{1.0 / sim_tick_rate});
+		constexpr auto idle_step = std::chrono::duration_cast<clock::duration>(
+				std::chrono::duration<double>{1.0 / idle_tick_rate});
+
+		auto last = clock::now();
+		auto next = last + step;
+
+		while (running_) {
+			auto now = clock::now();
+			auto delta = std::chrono::duration<double>(now - last).count();
+			last = now;
+
+			input_.begin_frame();
+			{
+				std::lock_guard lock{pending_mutex_};
+				for (size_t i = 0; i < pending_input_.size(); i++) {
+					auto &ev = pending_input_[i];
+					if (ev.down)
+						input_.key_down(ev.key, ev.time);
+					else
+						input_.key_up(ev.key, ev.time);
+				}
+				pending_input_.clear();
+			}
+
+			{
+				alloc_scope scope{tick_alloc_zone};
+				auto tick_start = clock::now();
+				ticker_cb_(delta, input_, ticker_ctx_);
+				tick_ms_ = ms_since_(tick_start);
+			}
+
+			if (!sim_idle_) {
+				std::this_thread::sleep_until(next);
+				next = std::max(next + step, clock::now());
+				continue;
+			}
+
+			std::unique_lock lock{pending_mutex_};
+			wake_sim_.wait_until(lock, last + idle_step, [this] {
+				return pending_input_.size() > 0 || !sim_idle_ || !running_;
+			});
+			next = clock::now() + step;
+		}
+	}
+
+	static double ms_since_(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void set_idle_(bool idle) {
+		if (idle == idle_)
+			return;
+
+		idle_ = idle;
+		if constexpr (threaded_simulation) {
+			{
+				std::lock_guard lock{pending_mutex_};
+				sim_idle_ = idle;
+			}
+			wake_sim_.notify_one();
+		}
+
+		if (idle)
+			emscripten_set_main_loop_timing(EM_TIMING_SETTIMEOUT, 1000 / idle_tick_rate);
+		else
+			emscripten_set_main_loop_timing(EM_TIMING_RAF, 1);
+	}
+
 	SDL_Window *wnd_ = nullptr;
 	SDL_GLContext ctx_;
 	int scale_ = 1;
 
+	std::optional<upscaler> upscaler_;
+	bool offscreen_ = render_offscreen;
+
 	uint32_t last_ticks_ = 0;
+
+	// Owned by whichever thread ticks, key events reach the simulation
+	// thread through pending_input_.
 	input_state input_{};
 
+	struct key_stamp {
+		uint32_t type;
+		uint32_t timestamp;
+		SDL_Scancode key;
+		uint64_t counter;
+	};
+	spsc_queue<key_stamp, 64> key_stamps_;
+
+	std::mutex pending_mutex_;
+	input_ring pending_input_;
+	std::condition_variable wake_sim_;
+	std::thread sim_thread_;
+	std::atomic<bool> running_ = false;
+	// Mirrors idle_ for the simulation thread.
+	std::atomic<bool> sim_idle_ = false;
+
 	void *ticker_ctx_ = nullptr;
 	void (*ticker_cb_)(double, input_state &, void *) = nullptr;
 
 	void *renderer_ctx_ = nullptr;
 	void (*renderer_cb_)(void *) = nullptr;
+	frame_status (*status_cb_)(void *) = nullptr;
+	void (*quality_cb_)(void *, const quality_report &) = nullptr;
+
+	bool force_redraw_ = true;
+	bool idle_ = false;
+
+	frame_allocs allocs_;
+	bool steady_ = false;
+
+	quality_governor governor_;
+	// Written by whichever thread ticks.
+	std::atomic<double> tick_ms_ = 0;
+	bool show_stats_ = false;
 };